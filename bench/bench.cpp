@@ -0,0 +1,743 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Parser throughput benchmark. Runs every document of the corpus through
+// the parsers, which apply to it, and prints one JSON object with the
+// results, so that two runs can be compared with any JSON tool.
+//
+//   bench [--corpus <dir>] [--charsets <db>] [--time <seconds>] [--out <file>]
+//         [--sweep <dir>]
+//
+// Links with libweb; the corpus is in bench/corpus. The allocation
+// counts come from the replaced operator new (the library's one, if built
+// with LIBWEB_TRACK_ALLOCATIONS, the one below otherwise), so they cover
+// the C++ side only: expat and Gumbo allocate with malloc.
+//
+// Each case runs in a child process of its own, so that the peak RSS
+// belongs to that case alone; on Windows the cases run in-process and
+// the peak RSS is not reported.
+//
+// With --sweep, files of 1 MB, 50 MB and 1 GB are generated in the given
+// directory (and removed afterwards) and read with parsers::parseFile.
+//
+// The teardown cases build documents of 10k, 100k and 1M nodes and time
+// only the release on the calling thread, with the document freed in place
+// or handed to dom::reclaim; their nodes_per_s is the number of nodes let
+// go of per second of the caller's time.
+
+#include <dom/dom.hpp>
+#include <dom/parsers/encoding_db.hpp>
+#include <dom/parsers/xml.hpp>
+#include <dom/parsers/html.hpp>
+#include <dom/parsers/feed.hpp>
+#include <libweb/alloc_scope.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define BENCH_ISOLATED
+#endif
+
+#ifndef LIBWEB_TRACK_ALLOCATIONS
+namespace
+{
+	std::atomic<size_t> allocations{ 0 };
+	std::atomic<size_t> allocatedBytes{ 0 };
+}
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+#endif
+
+namespace bench
+{
+#ifdef LIBWEB_TRACK_ALLOCATIONS
+	struct AllocCounter
+	{
+		libweb::alloc_scope scope;
+		size_t count() const { return scope.count(); }
+		size_t bytes() const { return scope.bytes(); }
+	};
+#else
+	struct AllocCounter
+	{
+		size_t startCount = allocations.load();
+		size_t startBytes = allocatedBytes.load();
+		size_t count() const { return allocations.load() - startCount; }
+		size_t bytes() const { return allocatedBytes.load() - startBytes; }
+	};
+#endif
+}
+
+namespace bench
+{
+	enum KIND
+	{
+		XML,
+		HTML,
+		XHTML, // parsed both ways
+		FEED   // also read into dom::parsers::feed::Feed, both ways
+	};
+
+	struct Entry
+	{
+		const char* name;
+		KIND kind;
+	};
+
+	static const Entry corpus[] = {
+		{ "tiny.xml", XML },
+		{ "tiny.html", HTML },
+		{ "rss.xml", FEED },
+		{ "atom.xml", FEED },
+		{ "large.xhtml", XHTML },
+		{ "soup-windows-1250.html", HTML },
+		{ "soup-iso-8859-2.html", HTML },
+		{ "soup-koi8-r.html", HTML },
+		{ "soup-windows-1252.html", HTML },
+	};
+
+	enum API
+	{
+		XML_PARSE_DOCUMENT,  // pooled parser
+		XML_FRESH_PARSER,    // xml::create for every document
+		HTML_PARSE_DOCUMENT,
+		HTML_FRESH_PARSER,
+		FROM_FILE,
+		FEED_TYPED,
+		FEED_DOM_XPATH,
+		PARSE_FILE,          // the --sweep files
+		MUTABLE_QUERY,       // parse, a few XPaths and a walk
+		READONLY_QUERY,      // the same on a READONLY_DOCUMENT
+		TEARDOWN_RESET,      // the last DocumentPtr reset by the caller
+		TEARDOWN_RECLAIM     // the same through dom::reclaim
+	};
+
+	static const char* apiName(API api)
+	{
+		switch (api)
+		{
+		case XML_PARSE_DOCUMENT: return "xml::parseDocument";
+		case XML_FRESH_PARSER: return "xml::create+parseDocument";
+		case HTML_PARSE_DOCUMENT: return "html::parseDocument";
+		case HTML_FRESH_PARSER: return "html::create+parseDocument";
+		case FROM_FILE: return "Document::fromFile";
+		case FEED_TYPED: return "feed::parse";
+		case FEED_DOM_XPATH: return "xml::parseDocument+XPath";
+		case PARSE_FILE: return "parsers::parseFile";
+		case MUTABLE_QUERY: return "xml::parseDocument+query";
+		case READONLY_QUERY: return "xml::parseDocument(READONLY)+query";
+		case TEARDOWN_RESET: return "DocumentPtr::reset";
+		case TEARDOWN_RECLAIM: return "dom::reclaim";
+		}
+		return "";
+	}
+
+	struct Case
+	{
+		API api;
+		std::string file;
+		std::string path;
+		size_t nodes; // of the generated teardown document
+	};
+
+	// Plain data only; it is sent over a pipe from the child process
+	struct Measure
+	{
+		bool ok;
+		size_t bytes;
+		size_t iterations;
+		double seconds;
+		size_t nodes;
+		size_t allocations;
+		size_t allocatedBytes;
+		size_t peakRss; // kB; 0, if not known
+	};
+
+	struct Result
+	{
+		std::string file;
+		API api;
+		Measure measure;
+	};
+
+	struct NodeCounter : dom::AttributeVisitor
+	{
+		size_t count = 0;
+
+		void onAttribute(const dom::string_view&, const dom::string_view&) override { ++count; }
+
+		void visit(const dom::NodePtr& node)
+		{
+			for (auto child = node->firstChild(); child; child = child->nextSibling())
+			{
+				++count;
+				if (child->nodeType() == dom::ELEMENT_NODE)
+					std::static_pointer_cast<dom::Element>(child)->visitAttributes(*this);
+				visit(child);
+			}
+		}
+	};
+
+	static size_t countNodes(const dom::DocumentPtr& doc)
+	{
+		NodeCounter counter;
+		auto fragment = doc->associatedFragment();
+		if (fragment)
+			counter.visit(fragment);
+		else
+			counter.visit(doc);
+		return counter.count;
+	}
+
+	static size_t peakRss()
+	{
+#ifdef BENCH_ISOLATED
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage))
+			return 0;
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024; // bytes there
+#else
+		return usage.ru_maxrss;
+#endif
+#else
+		return 0; // process-wide and monotonic; meaningless without isolation
+#endif
+	}
+
+	static bool readFile(const std::string& path, std::vector<char>& contents)
+	{
+		FILE* f = fopen(path.c_str(), "rb");
+		if (!f)
+			return false;
+
+		char buffer[8192];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			contents.insert(contents.end(), buffer, buffer + read);
+		fclose(f);
+		return true;
+	}
+
+	static std::string childText(const dom::NodePtr& node, const std::string& path)
+	{
+		auto child = node->find(path);
+		return child ? child->stringValue() : std::string();
+	}
+
+	// What a reader would have to do without the typed parser: the whole
+	// DOM and an XPath lookup for every field
+	static bool feedFromDom(const std::vector<char>& contents, dom::parsers::feed::Feed& feed)
+	{
+		auto doc = dom::parsers::xml::parseDocument(std::string(), contents.data(), contents.size());
+		if (!doc)
+			return false;
+
+		auto root = doc->documentElement();
+		if (!root)
+			return false;
+
+		dom::NodePtr top = doc;
+		bool atom = root->tagName() == "feed";
+		feed.format = atom ? dom::parsers::feed::ATOM : dom::parsers::feed::RSS2;
+		feed.title = childText(top, atom ? "/feed/title" : "/rss/channel/title");
+
+		auto items = top->findall(atom ? "/feed/entry" : "/rss/channel/item", nullptr);
+		if (!items)
+			return true;
+
+		for (size_t i = 0, length = items->length(); i < length; ++i)
+		{
+			auto node = items->item(i);
+			dom::parsers::feed::Item item;
+			item.title = childText(node, "title");
+			item.guid = childText(node, atom ? "id" : "guid");
+			item.publishedText = childText(node, atom ? "published" : "pubDate");
+			item.published = dom::parsers::feed::parseDate(item.publishedText);
+			item.summary.text = childText(node, atom ? "summary" : "description");
+			if (atom)
+			{
+				auto link = node->find("link/@href");
+				if (link)
+					item.link = link->stringValue();
+			}
+			else
+				item.link = childText(node, "link");
+			feed.items.push_back(std::move(item));
+		}
+		return true;
+	}
+
+	// The query-only workload: a handful of XPaths and one walk over the
+	// whole tree; returns the number of nodes seen
+	static size_t query(const dom::DocumentPtr& doc)
+	{
+		static const char* paths[] = { "//title", "//link", "//item/title", "//*[@rel='alternate']" };
+
+		dom::NodePtr top = doc;
+		size_t found = 0;
+		for (auto path : paths)
+		{
+			auto list = top->findall(path, nullptr);
+			if (list)
+				found += list->length();
+		}
+		return found + countNodes(doc);
+	}
+
+	// nodes gets the number of nodes (or the feed items) seen, if asked for
+	static bool parse(API api, const std::string& path, const std::vector<char>& contents, size_t* nodes = nullptr)
+	{
+		namespace parsers = dom::parsers;
+
+		dom::DocumentPtr doc;
+		switch (api)
+		{
+		case XML_PARSE_DOCUMENT:
+			doc = parsers::xml::parseDocument(std::string(), contents.data(), contents.size());
+			break;
+		case XML_FRESH_PARSER:
+			doc = parsers::parseDocument(parsers::xml::create(std::string()), contents.data(), contents.size());
+			break;
+		case HTML_PARSE_DOCUMENT:
+			doc = parsers::html::parseDocument(std::string(), contents.data(), contents.size());
+			break;
+		case HTML_FRESH_PARSER:
+			doc = parsers::parseDocument(parsers::html::create(std::string()), contents.data(), contents.size());
+			break;
+		case FROM_FILE:
+			doc = dom::Document::fromFile(path);
+			break;
+		case FEED_TYPED:
+		case FEED_DOM_XPATH:
+			{
+				parsers::feed::Feed feed;
+				bool ok = api == FEED_TYPED
+					? parsers::feed::parse(std::string(), contents.data(), contents.size(), feed)
+					: feedFromDom(contents, feed);
+				if (nodes)
+					*nodes = feed.items.size();
+				return ok;
+			}
+		case MUTABLE_QUERY:
+		case READONLY_QUERY:
+			{
+				doc = parsers::xml::parseDocument(std::string(), contents.data(), contents.size(),
+					api == READONLY_QUERY ? parsers::READONLY_DOCUMENT : parsers::MUTABLE_DOCUMENT);
+				if (!doc)
+					return false;
+				size_t seen = query(doc);
+				if (nodes)
+					*nodes = seen;
+				return true;
+			}
+		case PARSE_FILE:
+			{
+				// only the head is kept, so that the DOM does not hide
+				// the cost of reading the file
+				parsers::Projection head{ "/sweep/head" };
+				doc = parsers::parseFile(parsers::xml::create(std::string(), head), path);
+				if (nodes)
+					*nodes = 0;
+				return !!doc;
+			}
+		case TEARDOWN_RESET:
+		case TEARDOWN_RECLAIM:
+			return false; // built and timed by teardown()
+		}
+
+		if (!doc)
+			return false;
+		if (nodes)
+			*nodes = countNodes(doc);
+		return true;
+	}
+
+	static Measure run(const Case& test, double budget)
+	{
+		Measure result = { false, 0, 0, 0.0, 0, 0, 0, 0 };
+
+		// the sweep files are read by the parser itself, and at 1 GB
+		// a single timed run is all there is time for
+		std::vector<char> contents;
+		bool single = test.api == PARSE_FILE;
+		if (single)
+		{
+			FILE* f = fopen(test.path.c_str(), "rb");
+			if (!f)
+				return result;
+			fseek(f, 0, SEEK_END);
+			result.bytes = (size_t)ftell(f);
+			fclose(f);
+		}
+		else
+		{
+			if (!readFile(test.path, contents))
+				return result;
+			result.bytes = contents.size();
+
+			// the first run fills the parser pool and the charset cache and
+			// gives the node count; it is not timed
+			if (!parse(test.api, test.path, contents, &result.nodes))
+				return result;
+		}
+
+		using clock = std::chrono::steady_clock;
+		{
+			AllocCounter counter;
+			auto start = clock::now();
+			if (!parse(test.api, test.path, contents) && single)
+				return result;
+			result.allocations = counter.count();
+			result.allocatedBytes = counter.bytes();
+			if (single)
+			{
+				result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+				result.iterations = 1;
+			}
+		}
+
+		if (!single)
+		{
+			auto start = clock::now();
+			do
+			{
+				parse(test.api, test.path, contents);
+				++result.iterations;
+				result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+			} while (result.seconds < budget || result.iterations < 5);
+		}
+
+		result.peakRss = peakRss();
+		result.ok = true;
+		return result;
+	}
+
+	// <r><i a="v">text</i>...</r> of about the given number of nodes
+	static std::string synthetic(size_t nodes)
+	{
+		static const char item[] = "<i a=\"v\">text</i>";
+		std::string xml = "<r>";
+		xml.reserve((nodes / 3 + 1) * (sizeof(item) - 1) + 7);
+		for (size_t count = 0; count < nodes; count += 3)
+			xml.append(item, sizeof(item) - 1);
+		xml.append("</r>");
+		return xml;
+	}
+
+	static Measure teardown(const Case& test, double budget)
+	{
+		Measure result = { false, 0, 0, 0.0, 0, 0, 0, 0 };
+		std::string xml = synthetic(test.nodes);
+
+		// the budget covers the untimed builds as well, as the reclaimed
+		// releases alone could take forever to add up to it
+		using clock = std::chrono::steady_clock;
+		auto started = clock::now();
+		do
+		{
+			auto doc = dom::parsers::xml::parseDocument(std::string(), xml.data(), xml.size(), dom::parsers::MUTABLE_DOCUMENT);
+			if (!doc)
+				return result;
+			if (!result.nodes)
+				result.nodes = countNodes(doc);
+
+			auto start = clock::now();
+			if (test.api == TEARDOWN_RECLAIM)
+				dom::reclaim(std::move(doc));
+			else
+				doc.reset();
+			result.seconds += std::chrono::duration<double>(clock::now() - start).count();
+			++result.iterations;
+		} while (std::chrono::duration<double>(clock::now() - started).count() < budget || result.iterations < 5);
+
+		result.peakRss = peakRss();
+		result.ok = true;
+		return result;
+	}
+
+	static Measure measure(const Case& test, double budget)
+	{
+		if (test.api == TEARDOWN_RESET || test.api == TEARDOWN_RECLAIM)
+			return teardown(test, budget);
+		return run(test, budget);
+	}
+
+	static Measure isolated(const Case& test, double budget)
+	{
+#ifdef BENCH_ISOLATED
+		Measure result = { false, 0, 0, 0.0, 0, 0, 0, 0 };
+
+		int fds[2];
+		if (pipe(fds))
+			return measure(test, budget);
+
+		fflush(nullptr);
+		pid_t child = fork();
+		if (child < 0)
+		{
+			close(fds[0]);
+			close(fds[1]);
+			return measure(test, budget);
+		}
+
+		if (!child)
+		{
+			close(fds[0]);
+			Measure result = measure(test, budget);
+			ssize_t written = write(fds[1], &result, sizeof(result));
+			_exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+		}
+
+		close(fds[1]);
+		Measure received;
+		if (read(fds[0], &received, sizeof(received)) == (ssize_t)sizeof(received))
+			result = received;
+		close(fds[0]);
+
+		int status;
+		waitpid(child, &status, 0);
+		return result;
+#else
+		return measure(test, budget);
+#endif
+	}
+
+	// <sweep><head/><item>...</item>...</sweep> of about the given size
+	static bool generate(const std::string& path, size_t size)
+	{
+		FILE* f = fopen(path.c_str(), "wb");
+		if (!f)
+			return false;
+
+		static const char item[] =
+			"<item id=\"x\"><title>Lorem ipsum dolor sit amet</title>"
+			"<text>Consectetur adipiscing elit, sed do eiusmod tempor incididunt "
+			"ut labore et dolore magna aliqua. Ut enim ad minim veniam.</text></item>\n";
+
+		bool ok = fputs("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<sweep><head>sweep</head>\n", f) >= 0;
+		for (size_t written = 0; ok && written < size; written += sizeof(item) - 1)
+			ok = fputs(item, f) >= 0;
+		ok = ok && fputs("</sweep>\n", f) >= 0;
+		return !fclose(f) && ok;
+	}
+
+	static void print(FILE* out, const std::vector<Result>& results, double budget)
+	{
+		fprintf(out, "{\n  \"time_per_case\": %.3f,\n  \"results\": [", budget);
+		const char* sep = "\n";
+		for (auto&& result : results)
+		{
+			auto& m = result.measure;
+			double mb = m.seconds > 0 ? m.bytes * (double)m.iterations / m.seconds / 1000000.0 : 0.0;
+			double nodes = m.seconds > 0 ? m.nodes * (double)m.iterations / m.seconds : 0.0;
+
+			fprintf(out, "%s    {\n", sep);
+			fprintf(out, "      \"file\": \"%s\",\n", result.file.c_str()); // corpus names need no escaping
+			fprintf(out, "      \"api\": \"%s\",\n", apiName(result.api));
+			fprintf(out, "      \"ok\": %s,\n", m.ok ? "true" : "false");
+			fprintf(out, "      \"bytes\": %zu,\n", m.bytes);
+			fprintf(out, "      \"nodes\": %zu,\n", m.nodes);
+			fprintf(out, "      \"iterations\": %zu,\n", m.iterations);
+			fprintf(out, "      \"seconds\": %.6f,\n", m.seconds);
+			fprintf(out, "      \"mb_per_s\": %.3f,\n", mb);
+			fprintf(out, "      \"nodes_per_s\": %.1f,\n", nodes);
+			fprintf(out, "      \"allocations_per_doc\": %zu,\n", m.allocations);
+			fprintf(out, "      \"allocated_bytes_per_doc\": %zu,\n", m.allocatedBytes);
+			if (m.peakRss)
+				fprintf(out, "      \"peak_rss_kb\": %zu\n", m.peakRss);
+			else
+				fprintf(out, "      \"peak_rss_kb\": null\n");
+			fprintf(out, "    }");
+			sep = ",\n";
+		}
+		fprintf(out, "\n  ]\n}\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string corpus = "bench/corpus";
+	std::string charsets;
+	std::string output;
+	std::string sweep;
+	double budget = 1.0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (i + 1 < argc && arg == "--corpus")
+			corpus = argv[++i];
+		else if (i + 1 < argc && arg == "--charsets")
+			charsets = argv[++i];
+		else if (i + 1 < argc && arg == "--time")
+			budget = atof(argv[++i]);
+		else if (i + 1 < argc && arg == "--out")
+			output = argv[++i];
+		else if (i + 1 < argc && arg == "--sweep")
+			sweep = argv[++i];
+		else
+		{
+			fprintf(stderr, "usage: %s [--corpus <dir>] [--charsets <db>] [--time <seconds>] [--out <file>] [--sweep <dir>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!charsets.empty())
+		dom::parsers::init(charsets);
+
+	std::vector<bench::Case> cases;
+	for (auto&& entry : bench::corpus)
+	{
+		std::string path = corpus + "/" + entry.name;
+		auto add = [&](bench::API api) { cases.push_back(bench::Case{ api, entry.name, path, 0 }); };
+
+		if (entry.kind != bench::HTML)
+		{
+			add(bench::XML_PARSE_DOCUMENT);
+			add(bench::XML_FRESH_PARSER);
+			add(bench::MUTABLE_QUERY);
+			add(bench::READONLY_QUERY);
+		}
+		if (entry.kind == bench::HTML || entry.kind == bench::XHTML)
+		{
+			add(bench::HTML_PARSE_DOCUMENT);
+			add(bench::HTML_FRESH_PARSER);
+		}
+		add(bench::FROM_FILE);
+		if (entry.kind == bench::FEED)
+		{
+			add(bench::FEED_TYPED);
+			add(bench::FEED_DOM_XPATH);
+		}
+	}
+
+	struct Teardown
+	{
+		const char* name;
+		size_t nodes;
+	};
+	static const Teardown teardowns[] = {
+		{ "teardown-10k", 10000 },
+		{ "teardown-100k", 100000 },
+		{ "teardown-1M", 1000000 },
+	};
+	for (auto&& teardown : teardowns)
+	{
+		cases.push_back(bench::Case{ bench::TEARDOWN_RESET, teardown.name, std::string(), teardown.nodes });
+		cases.push_back(bench::Case{ bench::TEARDOWN_RECLAIM, teardown.name, std::string(), teardown.nodes });
+	}
+
+	struct SweepFile
+	{
+		const char* name;
+		size_t size;
+	};
+	static const SweepFile sweepFiles[] = {
+		{ "sweep-1M.xml", (size_t)1 << 20 },
+		{ "sweep-50M.xml", (size_t)50 << 20 },
+		{ "sweep-1G.xml", (size_t)1 << 30 },
+	};
+
+	std::vector<std::string> generated;
+	if (!sweep.empty())
+	{
+		for (auto&& file : sweepFiles)
+		{
+			std::string path = sweep + "/" + file.name;
+			if (!bench::generate(path, file.size))
+			{
+				fprintf(stderr, "%s: cannot write\n", path.c_str());
+				remove(path.c_str());
+				continue;
+			}
+			generated.push_back(path);
+			cases.push_back(bench::Case{ bench::PARSE_FILE, file.name, path, 0 });
+		}
+	}
+
+	std::vector<bench::Result> results;
+	for (auto&& test : cases)
+	{
+		bench::Result result = { test.file, test.api, bench::isolated(test, budget) };
+		if (!result.measure.ok)
+			fprintf(stderr, "%s: %s failed\n", (test.path.empty() ? test.file : test.path).c_str(), bench::apiName(test.api));
+		results.push_back(result);
+	}
+
+	for (auto&& path : generated)
+		remove(path.c_str());
+
+	FILE* out = stdout;
+	if (!output.empty())
+	{
+		out = fopen(output.c_str(), "w");
+		if (!out)
+		{
+			fprintf(stderr, "%s: cannot write\n", output.c_str());
+			return 1;
+		}
+	}
+
+	bench::print(out, results, budget);
+
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
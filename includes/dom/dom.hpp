@@ -39,6 +39,11 @@ namespace dom
 {
 	void Print(const NodePtr& node, bool ignorews = false, size_t depth = 0);
 	void Print(const NodeListPtr& subs, bool ignorews = false, size_t depth = 0);
+
+	// Takes the reference away from the caller and drops it on a
+	// background thread, so that freeing a large document does not add
+	// to the latency of the calling thread.
+	void reclaim(DocumentPtr&& doc);
 }
 
 #endif // __DOM_HPP__
\ No newline at end of file
@@ -97,6 +97,9 @@ namespace dom
 			SimpleSelector m_selector;
 			Predicates m_preds;
 			void select(const NodePtr& context, std::list<NodePtr>& list);
+			bool accepts(const NodePtr& node);
+			bool descendants() const;
+			bool indexable(std::string& name, std::string& value) const;
 		};
 		typedef std::list<Segment> Segments;
 
@@ -107,6 +110,7 @@ namespace dom
 			NodeListPtr findall(const NodePtr& context);
 			Segments m_segments;
 		private:
+			std::list<NodePtr> select(const NodePtr& context);
 			const char* readSegment(const char* ptr, const char* end, Segment& seg, const Namespaces& ns);
 		};
 		std::ostream& operator << (std::ostream& o, const XPath& qname);
@@ -34,6 +34,7 @@ namespace dom
 		virtual std::string name() const { return nodeName(); }
 		virtual std::string value() const { return nodeValue(); }
 		virtual void value(const std::string& val) { nodeValue(val); }
+		virtual void value(std::string&& val) { nodeValue(std::move(val)); }
 		virtual ElementPtr ownerElement()
 		{
 			return std::static_pointer_cast<Element>(parentNode());
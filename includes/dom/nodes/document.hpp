@@ -30,10 +30,18 @@
 
 namespace dom
 {
+	struct StringPoolStats
+	{
+		size_t strings;    // distinct values kept in the pool
+		size_t references; // nodes currently pointing to a pooled value
+		size_t bytesSaved; // bytes of values not copied thanks to the pool
+	};
+
 	struct Document : Node
 	{
 		static DocumentPtr create();
 		static DocumentPtr fromFile(const filesystem::path& path);
+		static DocumentPtr fromBuffer(const void* data, size_t size);
 
 		virtual ElementPtr documentElement() = 0;
 		virtual void setDocumentElement(const ElementPtr& elem) = 0;
@@ -41,12 +49,34 @@ namespace dom
 		virtual void setFragment(const DocumentFragmentPtr& fragment) = 0;
 
 		virtual ElementPtr createElement(const std::string& tagName) = 0;
+		virtual ElementPtr createElement(std::string&& tagName) = 0;
 		virtual TextPtr createTextNode(const std::string& data) = 0;
+		virtual TextPtr createTextNode(std::string&& data) = 0;
 		virtual AttributePtr createAttribute(const std::string& name, const std::string& value) = 0;
+		virtual AttributePtr createAttribute(std::string&& name, std::string&& value) = 0;
+		// the namespace is given up front and never re-resolved from the node's ancestors
+		virtual ElementPtr createElementNS(const std::string& ns, const std::string& qualifiedName) = 0;
+		virtual AttributePtr createAttributeNS(const std::string& ns, const std::string& qualifiedName, const std::string& value) = 0;
 		virtual DocumentFragmentPtr createDocumentFragment() = 0;
+		virtual bool adoptNode(const NodePtr& node) = 0;
 
 		virtual NodeListPtr getElementsByTagName(const std::string& tagName) = 0;
 		virtual ElementPtr getElementById(const std::string& elementId) = 0;
+
+		// Secondary index of attribute values; once an attribute name is
+		// indexed, getElementsByAttribute and XPath predicates in form of
+		// //tag[@name='value'] no longer need to scan the whole tree.
+		virtual bool indexAttribute(const std::string& name) = 0;
+		virtual bool hasAttributeIndex(const std::string& name) = 0;
+		virtual NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value) = 0;
+		// Only the elements below the scope; all of them, if the scope is
+		// the document itself.
+		virtual NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value, const NodePtr& scope) = 0;
+
+		// Optional de-duplication of attribute values and texts of up to
+		// maxTextLength bytes; affects the nodes created afterwards.
+		virtual void enableStringPool(size_t maxTextLength = 64) = 0;
+		virtual StringPoolStats stringPoolStats() = 0;
 	};
 }
 
@@ -29,17 +29,26 @@
 
 namespace dom
 {
+	struct AttributeVisitor
+	{
+		virtual ~AttributeVisitor() {}
+		virtual void onAttribute(const string_view& name, const string_view& value) = 0;
+	};
+
 	struct Element : ParentNode
 	{
 		virtual std::string tagName() const { return nodeName(); }
 		virtual std::string stringValue() override { return innerText(); }
 		virtual std::string getAttribute(const std::string& name) = 0;
+		virtual string_view getAttributeView(const std::string& name) = 0;
 		virtual AttributePtr getAttributeNode(const std::string& name) = 0;
 		virtual bool setAttribute(const AttributePtr& attr) = 0;
 		virtual bool removeAttribute(const AttributePtr& attr) = 0;
 		virtual bool setAttribute(const std::string& attr, const std::string& value) = 0;
+		virtual bool setAttribute(std::string&& attr, std::string&& value) = 0;
 		virtual bool removeAttribute(const std::string& attr) = 0;
 		virtual NodeListPtr getAttributes() = 0;
+		virtual void visitAttributes(AttributeVisitor& visitor) = 0; // same order as getAttributes, without building the list
 		virtual bool hasAttribute(const std::string& name) = 0;
 		virtual NodeListPtr getElementsByTagName(const std::string& tagName) = 0;
 		virtual std::string innerText() = 0;
@@ -28,6 +28,7 @@
 #include <string>
 #include <iostream>
 #include <dom/domfwd.hpp>
+#include <dom/string_view.hpp>
 
 namespace dom
 {
@@ -78,6 +79,12 @@ namespace dom
 		virtual std::string nodeValue() const = 0;
 		virtual std::string stringValue() { return nodeValue(); } // nodeValue for TEXT, ATTRIBUTE, and - coincidently - DOCUMENT; innerText for ELEMENT; used in xpath
 		virtual void nodeValue(const std::string& val) = 0;
+		virtual void nodeValue(std::string&& val) = 0;
+
+		// no-copy versions of nodeName and nodeValue; the views are valid
+		// until the node is changed or destroyed
+		virtual string_view nodeNameView() const = 0;
+		virtual string_view nodeValueView() const = 0;
 		virtual NODE_TYPE nodeType() const = 0;
 
 		virtual NodePtr parentNode() = 0;
@@ -32,6 +32,7 @@ namespace dom
 	struct Text: ChildNode
 	{
 		virtual std::string data() const { return nodeValue(); }
+		virtual string_view dataView() const { return nodeValueView(); }
 	};
 }
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_PARSERS_FEED_HPP__
+#define __DOM_PARSERS_FEED_HPP__
+
+#include <filesystem.hpp>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace dom { namespace parsers { namespace feed {
+
+	// Reads RSS 2.0 (and 0.9x), RSS 1.0 (RDF) and Atom 1.0 straight from
+	// the expat events into the structures below; no DOM is built. Only
+	// the fields a reader needs are kept. The dates are also available in
+	// their original text, in case they do not parse.
+
+	enum FORMAT
+	{
+		UNKNOWN,
+		RSS2,
+		RSS1,
+		ATOM
+	};
+
+	struct Link
+	{
+		std::string href;
+		std::string rel;  // "alternate", if not given
+		std::string type;
+	};
+
+	struct Enclosure
+	{
+		std::string url;
+		std::string type;
+		size_t length = 0;
+	};
+
+	enum CONTENT_TYPE
+	{
+		CONTENT_TEXT,
+		CONTENT_HTML, // escaped HTML, like the RSS description
+		CONTENT_XHTML // Atom inline XHTML, serialized back to markup
+	};
+
+	struct Content
+	{
+		std::string text;
+		CONTENT_TYPE type = CONTENT_TEXT;
+	};
+
+	struct Item
+	{
+		std::string title;
+		std::string link; // the first alternate link
+		std::vector<Link> links;
+		std::string guid; // RSS guid, RDF about or Atom id
+		std::string author;
+		std::string publishedText;
+		std::string updatedText;
+		time_t published = 0;
+		time_t updated = 0;
+		Content summary;  // description, atom:summary
+		Content content;  // content:encoded, atom:content
+		std::vector<std::string> categories;
+		std::vector<Enclosure> enclosures;
+	};
+
+	struct Feed
+	{
+		FORMAT format = UNKNOWN;
+		std::string title;
+		std::string link;
+		std::vector<Link> links;
+		std::string description; // RSS description, Atom subtitle
+		std::string language;
+		std::string updatedText;
+		time_t updated = 0;
+		std::vector<Item> items;
+	};
+
+	// RFC 822 (RSS) and RFC 3339 (Atom) dates; 0, if the text is neither
+	time_t parseDate(const std::string& text);
+
+	// false, if the document is not well-formed or not a feed
+	bool parse(const std::string& encoding, const void* data, size_t size, Feed& feed);
+	bool parseFile(const filesystem::path& path, Feed& feed);
+}}}
+
+#endif // __DOM_PARSERS_FEED_HPP__
@@ -28,24 +28,92 @@
 #include <filesystem.hpp>
 #include <dom/nodes/document.hpp>
 #include <dom/parsers/parser.hpp>
+#include <dom/parsers/projection.hpp>
+#include <initializer_list>
+#include <vector>
 
 namespace dom { namespace parsers { namespace html {
 
-	ParserPtr create(const std::string& encoding);
+	ParserPtr create(const std::string& encoding, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
+	ParserPtr create(const std::string& encoding, const Projection& projection, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
 
-	static inline DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size)
-	{
-		auto parser = create(encoding);
-		if (!parser)
-			return nullptr;
-
-		if (!parser->onData(data, size))
-			return nullptr;
+	// reuses the parsers through a per-thread pool
+	DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
 
-		return parser->onFinish();
+	// Parses a snippet (like the description of a feed item) as the
+	// contents of the context element, into a new fragment of the doc.
+	// The text must already be UTF-8: there is no charset detection and no
+	// html, head or body around the nodes. Returns nullptr for read-only
+	// documents.
+	DocumentFragmentPtr parseFragment(const DocumentPtr& doc, const char* data, size_t size, const std::string& context = "body");
+	inline DocumentFragmentPtr parseFragment(const DocumentPtr& doc, const std::string& html, const std::string& context = "body")
+	{
+		return parseFragment(doc, html.data(), html.length(), context);
 	}
 
 	void serialize(OutStream& stream, const NodePtr& node);
+
+	// The allow-list for the sanitizer. Tags not on the list are removed,
+	// but their contents stay, unless the tag is on the drop list (like
+	// script or style, where the contents make no sense without the tag).
+	// An attribute stays, if it is allowed on its tag or on all tags; an
+	// URL attribute must also use one of the allowed schemes (relative
+	// URLs always pass). Comments and foreign (SVG, MathML) content are
+	// always removed.
+	class Policy
+	{
+	public:
+		struct Tag
+		{
+			std::string name;
+			std::vector<std::string> attributes;
+		};
+
+		Policy(); // drops head, script, style, template, noscript, iframe, object and embed
+
+		Policy& allow(const std::string& tag, std::initializer_list<const char*> attributes = {});
+		Policy& allowAttribute(const std::string& name); // on all allowed tags
+		Policy& urlAttribute(const std::string& name);
+		Policy& allowScheme(const std::string& scheme);
+		Policy& drop(const std::string& tag);
+
+		const std::vector<Tag>& tags() const { return m_tags; }
+		const std::vector<std::string>& attributes() const { return m_attributes; }
+		const std::vector<std::string>& urlAttributes() const { return m_urlAttributes; }
+		const std::vector<std::string>& schemes() const { return m_schemes; }
+		const std::vector<std::string>& dropped() const { return m_dropped; }
+
+		// formatting, lists, tables, links and images over http(s)
+		static Policy feed();
+
+	private:
+		std::vector<Tag> m_tags;
+		std::vector<std::string> m_attributes;
+		std::vector<std::string> m_urlAttributes;
+		std::vector<std::string> m_schemes;
+		std::vector<std::string> m_dropped;
+	};
+
+	// Parses the HTML and writes the allowed parts of it straight from the
+	// Gumbo tree; no DOM is built. The policy is compiled in createSanitizer;
+	// one sanitizer may serve any number of threads at once.
+	struct Sanitizer
+	{
+		virtual ~Sanitizer() {}
+		// the encoding is a hint, as in create
+		virtual bool sanitize(const std::string& encoding, const void* data, size_t size, OutStream& stream) const = 0;
+	};
+	using SanitizerPtr = std::shared_ptr<Sanitizer>;
+
+	SanitizerPtr createSanitizer(const Policy& policy);
+
+	// The visible text of the HTML, as UTF-8, without building a DOM.
+	// Script, style and hidden elements are skipped, whitespace outside
+	// of pre is collapsed, and the blocks are separated with line breaks.
+	// The text is cut at limit characters (code points, with the breaks
+	// and spaces between the blocks); 0 means all. With a limit, only as
+	// much of the input is parsed, as it takes to reach it.
+	std::string extractText(const std::string& encoding, const void* data, size_t size, size_t limit = 0);
 }}}
 
 #endif // __DOM_PARSERS_HTML_HPP__
@@ -25,17 +25,75 @@
 #ifndef __DOM_PARSERS_PARSER_HPP__
 #define __DOM_PARSERS_PARSER_HPP__
 
+#include <atomic>
+#include <cstring>
 #include <filesystem.hpp>
 #include <dom/nodes/document.hpp>
 
 namespace dom { namespace parsers {
 
+	enum DOCUMENT_MODE
+	{
+		MUTABLE_DOCUMENT,  // regular DOM, every node is a separate object
+		POOLED_DOCUMENT,   // regular DOM sharing repeated attribute values and short texts
+		READONLY_DOCUMENT  // flat, read-only tape; cheaper to build, query and destroy
+	};
+
+	// Bounds of a single parse; 0 means no bound
+	struct Limits
+	{
+		size_t maxInputBytes = 0;
+		size_t maxNodes = 0;      // elements; the text is bounded by maxTextBytes
+		size_t maxDepth = 0;
+		size_t maxAttributes = 0; // on a single element
+		size_t maxTextBytes = 0;  // all the text of the document together
+	};
+
+	// Set from any thread to stop the parse it was given to
+	class CancellationToken
+	{
+		std::atomic<bool> m_cancelled;
+	public:
+		CancellationToken() : m_cancelled(false) {}
+		void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+		bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+	};
+	using CancellationTokenPtr = std::shared_ptr<CancellationToken>;
+
+	enum PARSE_ERROR
+	{
+		PARSE_OK,
+		PARSE_FAILED, // the input is broken beyond repair
+		LIMIT_INPUT,
+		LIMIT_NODES,
+		LIMIT_DEPTH,
+		LIMIT_ATTRIBUTES,
+		LIMIT_TEXT,
+		PARSE_CANCELLED
+	};
+
 	struct Parser
 	{
 		virtual ~Parser() {};
 		virtual bool supportsChunks() const = 0;
 		virtual bool onData(const void* data, size_t length) = 0;
 		virtual DocumentPtr onFinish() = 0;
+
+		// Parsers with an input buffer of their own may let the caller
+		// read straight into it: fill up to length bytes of dataBuffer(),
+		// then report the number of bytes read with onBufferData()
+		virtual void* dataBuffer(size_t length) { return nullptr; }
+		virtual bool onBufferData(size_t length) { return false; }
+
+		// Prepares the parser for the next document, keeping the mode it
+		// was created with; false, if the parser cannot be reused
+		virtual bool reset(const std::string& encoding) { return false; }
+
+		// Bounds the parses until the next reset. On hitting a limit, or
+		// on cancellation, the parse stops: onData or onFinish fail and
+		// lastError tells the reason.
+		virtual void setLimits(const Limits& limits, const CancellationTokenPtr& token = nullptr) {}
+		virtual PARSE_ERROR lastError() const { return PARSE_OK; }
 	};
 	using ParserPtr = std::shared_ptr<Parser>;
 
@@ -66,6 +124,51 @@ namespace dom { namespace parsers {
 		template <size_t length>
 		OutStream& operator<<(char (&s)[length]) { puts(s); return *this; }
 	};
+
+	// Collects the output in a fixed buffer and passes it on to the
+	// target stream in large pieces
+	class BufferedOutStream : public OutStream
+	{
+		enum { SIZE = 4096 };
+		OutStream& m_target;
+		char m_buffer[SIZE];
+		size_t m_used;
+	public:
+		explicit BufferedOutStream(OutStream& target) : m_target(target), m_used(0) {}
+		~BufferedOutStream() { flush(); }
+
+		using OutStream::puts;
+
+		void flush()
+		{
+			if (!m_used)
+				return;
+			m_target.puts(m_buffer, m_used);
+			m_used = 0;
+		}
+
+		void putc(char c) override
+		{
+			if (m_used == SIZE)
+				flush();
+			m_buffer[m_used++] = c;
+		}
+
+		void puts(const char* s, size_t length) override
+		{
+			if (length > SIZE - m_used)
+			{
+				flush();
+				if (length >= SIZE)
+				{
+					m_target.puts(s, length);
+					return;
+				}
+			}
+			memcpy(m_buffer + m_used, s, length);
+			m_used += length;
+		}
+	};
 }}
 
 #endif // __DOM_PARSERS_PARSER_HPP__
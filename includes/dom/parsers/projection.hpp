@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_PARSERS_PROJECTION_HPP__
+#define __DOM_PARSERS_PROJECTION_HPP__
+
+#include <dom/string_view.hpp>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace dom { namespace parsers {
+
+	// The parts of a document a parser should build. Each path is a list
+	// of tag names, like "/rss/channel/item/title" (from the root),
+	// "//item/title" or just "title" (anywhere in the document); a "*"
+	// matches any tag. The matching elements are kept with everything
+	// inside them, together with their ancestors (but nothing else from
+	// the ancestors). All other nodes are skipped by the parser.
+	class Projection
+	{
+	public:
+		struct Step
+		{
+			std::string name;
+			bool descendant; // preceded by "//"
+		};
+		using Path = std::vector<Step>;
+
+		Projection() {}
+		Projection(std::initializer_list<const char*> paths)
+		{
+			for (auto&& path : paths)
+				add(path);
+		}
+
+		void add(const std::string& path);
+		bool empty() const { return m_paths.empty(); }
+		const std::vector<Path>& paths() const { return m_paths; }
+
+		enum STATE
+		{
+			SKIP, // neither the element, nor anything inside it
+			PATH, // kept only if a descendant is kept
+			KEEP  // the element and the whole subtree
+		};
+
+		// State of one parse; enter and leave follow the start and end tags
+		class Matcher
+		{
+			struct Position
+			{
+				size_t path;
+				size_t step;
+			};
+
+			struct Level
+			{
+				size_t first; // positions of this level are [first, next level's first)
+				STATE state;
+			};
+
+			std::vector<Path> m_paths;
+			std::vector<Position> m_positions;
+			std::vector<Level> m_levels;
+
+		public:
+			Matcher() { reset(); }
+			explicit Matcher(const Projection& projection) : m_paths(projection.paths()) { reset(); }
+
+			void reset();
+			STATE enter(const string_view& name);
+			void leave();
+			STATE state() const { return m_levels.back().state; }
+		};
+
+	private:
+		std::vector<Path> m_paths;
+	};
+}}
+
+#endif // __DOM_PARSERS_PROJECTION_HPP__
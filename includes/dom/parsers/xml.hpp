@@ -28,23 +28,122 @@
 #include <filesystem.hpp>
 #include <dom/nodes/document.hpp>
 #include <dom/parsers/parser.hpp>
+#include <dom/parsers/projection.hpp>
+#include <dom/string_view.hpp>
 
 namespace dom { namespace parsers { namespace xml {
 
-	ParserPtr create(const std::string& encoding);
+	ParserPtr create(const std::string& encoding, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
+	ParserPtr create(const std::string& encoding, const Projection& projection, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
 
-	static inline DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size)
+	// With expat resolving the prefixes while parsing, every node gets its
+	// final QName when created. A prefix without a declaration (dc: or
+	// media: in many feeds) is then a fatal error; the parsers above
+	// resolve the names in the tree and keep such documents.
+	ParserPtr createNS(const std::string& encoding, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
+
+	// reuses the parsers through a per-thread pool
+	DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size, DOCUMENT_MODE mode = MUTABLE_DOCUMENT);
+
+	// Streaming access to the XML, for documents too big to be kept in
+	// memory as a whole. All the names, values and texts are views into
+	// the parser's buffers, valid only until the next event.
+
+	struct AttributeView
 	{
-		auto parser = create(encoding);
-		if (!parser)
-			return nullptr;
+		string_view name;
+		string_view value;
+	};
+
+	class AttributeList
+	{
+		const AttributeView* m_data;
+		size_t m_size;
+	public:
+		AttributeList() : m_data(nullptr), m_size(0) {}
+		AttributeList(const AttributeView* data, size_t size) : m_data(data), m_size(size) {}
+
+		const AttributeView* begin() const { return m_data; }
+		const AttributeView* end() const { return m_data + m_size; }
+		size_t size() const { return m_size; }
+		bool empty() const { return !m_size; }
+		const AttributeView& operator[](size_t i) const { return m_data[i]; }
 
-		if (!parser->onData(data, size))
+		const AttributeView* find(const string_view& name) const
+		{
+			for (auto&& attr : *this)
+			{
+				if (attr.name == name)
+					return &attr;
+			}
 			return nullptr;
+		}
+
+		string_view get(const string_view& name) const
+		{
+			auto attr = find(name);
+			return attr ? attr->value : string_view();
+		}
+	};
 
-		return parser->onFinish();
+	// Push (SAX) interface; the text between two tags is reported in
+	// one piece and only inside the root element.
+	struct Handler
+	{
+		virtual ~Handler() {}
+		virtual void onStartElement(const string_view& name, const AttributeList& attrs) {}
+		virtual void onEndElement(const string_view& name) {}
+		virtual void onText(const string_view& text) {}
+	};
+
+	struct SaxParser
+	{
+		virtual ~SaxParser() {}
+		virtual bool onData(const void* data, size_t length) = 0;
+		virtual bool onFinish() = 0;
+	};
+	using SaxParserPtr = std::shared_ptr<SaxParser>;
+
+	// The handler must outlive the parser
+	SaxParserPtr createSax(const std::string& encoding, Handler& handler);
+	bool parseFile(const std::string& encoding, Handler& handler, const filesystem::path& path);
+
+	static inline bool parse(const std::string& encoding, Handler& handler, const void* data, size_t size)
+	{
+		auto parser = createSax(encoding, handler);
+		if (!parser)
+			return false;
+
+		return parser->onData(data, size) && parser->onFinish();
 	}
 
+	// Pull interface
+	enum EVENT
+	{
+		EVENT_START_ELEMENT,
+		EVENT_END_ELEMENT,
+		EVENT_TEXT,
+		EVENT_NEED_DATA,    // call onData or onFinish, then next again; never returned by file readers
+		EVENT_END_DOCUMENT,
+		EVENT_ERROR
+	};
+
+	struct Reader
+	{
+		virtual ~Reader() {}
+		virtual bool onData(const void* data, size_t length) = 0;
+		virtual bool onFinish() = 0;
+
+		virtual EVENT next() = 0;
+		virtual string_view name() const = 0;  // START_ELEMENT and END_ELEMENT
+		virtual string_view text() const = 0;  // TEXT
+		virtual AttributeList attributes() const = 0; // START_ELEMENT
+	};
+	using ReaderPtr = std::shared_ptr<Reader>;
+
+	ReaderPtr createReader(const std::string& encoding);
+	ReaderPtr createReader(const std::string& encoding, const filesystem::path& path);
+
 }}}
 
 #endif // __DOM_PARSERS_XML_HPP__
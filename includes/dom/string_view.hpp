@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_STRING_VIEW_HPP__
+#define __DOM_STRING_VIEW_HPP__
+
+#include <string>
+#include <cstring>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+
+namespace dom
+{
+	using string_view = std::string_view;
+}
+#else
+namespace dom
+{
+	// Subset of std::string_view, for compilers without C++17
+	class string_view
+	{
+		const char* m_data;
+		size_t m_size;
+	public:
+		using const_iterator = const char*;
+		static const size_t npos = (size_t)-1;
+
+		string_view() : m_data(""), m_size(0) {}
+		string_view(const char* s) : m_data(s), m_size(strlen(s)) {}
+		string_view(const char* s, size_t length) : m_data(s), m_size(length) {}
+		string_view(const std::string& s) : m_data(s.c_str()), m_size(s.length()) {}
+
+		const char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+		size_t length() const { return m_size; }
+		bool empty() const { return !m_size; }
+		const_iterator begin() const { return m_data; }
+		const_iterator end() const { return m_data + m_size; }
+		char operator[](size_t pos) const { return m_data[pos]; }
+
+		string_view substr(size_t pos, size_t count = npos) const
+		{
+			if (pos > m_size)
+				pos = m_size;
+			if (count > m_size - pos)
+				count = m_size - pos;
+			return string_view(m_data + pos, count);
+		}
+
+		size_t find(char c, size_t pos = 0) const
+		{
+			for (; pos < m_size; ++pos)
+			{
+				if (m_data[pos] == c)
+					return pos;
+			}
+			return npos;
+		}
+
+		int compare(const string_view& other) const
+		{
+			size_t len = m_size < other.m_size ? m_size : other.m_size;
+			int ret = len ? memcmp(m_data, other.m_data, len) : 0;
+			if (ret)
+				return ret;
+			if (m_size == other.m_size)
+				return 0;
+			return m_size < other.m_size ? -1 : 1;
+		}
+
+		explicit operator std::string() const { return std::string(m_data, m_size); }
+	};
+
+	inline bool operator == (const string_view& lhs, const string_view& rhs)
+	{
+		return lhs.size() == rhs.size() && !lhs.compare(rhs);
+	}
+	inline bool operator != (const string_view& lhs, const string_view& rhs) { return !(lhs == rhs); }
+	inline bool operator < (const string_view& lhs, const string_view& rhs) { return lhs.compare(rhs) < 0; }
+}
+#endif
+
+#endif // __DOM_STRING_VIEW_HPP__
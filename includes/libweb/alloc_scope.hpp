@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBWEB_ALLOC_SCOPE_HPP__
+#define __LIBWEB_ALLOC_SCOPE_HPP__
+
+#include <string>
+#include <vector>
+
+// Allocation tracking is opt-in: define LIBWEB_TRACK_ALLOCATIONS for the
+// whole build (the library and everything using this header). The library
+// then replaces the global operator new and counts, what is allocated
+// inside an alloc_scope. Without the define, the scopes are empty and the
+// LIBWEB_ALLOC_SCOPE markers in the library compile to nothing.
+
+namespace libweb
+{
+#ifdef LIBWEB_TRACK_ALLOCATIONS
+	// Counts the allocations made on the current thread, while the scope
+	// is alive. The scopes nest; the allocations are counted in the
+	// innermost scope, which passes its counts on to the outer one, when
+	// it ends. A test can put a scope around a call and check the
+	// count() and bytes() against a budget.
+	class alloc_scope
+	{
+		const char* m_tag;
+		alloc_scope* m_outer;
+		size_t m_count;
+		size_t m_bytes;
+
+		friend void alloc_record(size_t size);
+	public:
+		explicit alloc_scope(const char* tag = nullptr);
+		~alloc_scope();
+		alloc_scope(const alloc_scope&) = delete;
+		alloc_scope& operator=(const alloc_scope&) = delete;
+
+		const char* tag() const { return m_tag; }
+		size_t count() const { return m_count; }
+		size_t bytes() const { return m_bytes; }
+	};
+
+	void alloc_record(size_t size);
+
+#define LIBWEB_ALLOC_NAME2(line) libweb_alloc_scope_ ## line
+#define LIBWEB_ALLOC_NAME(line) LIBWEB_ALLOC_NAME2(line)
+#define LIBWEB_ALLOC_SCOPE(tag) ::libweb::alloc_scope LIBWEB_ALLOC_NAME(__LINE__)(tag)
+#else
+	class alloc_scope
+	{
+	public:
+		explicit alloc_scope(const char* = nullptr) {}
+		const char* tag() const { return nullptr; }
+		size_t count() const { return 0; }
+		size_t bytes() const { return 0; }
+	};
+
+#define LIBWEB_ALLOC_SCOPE(tag)
+#endif
+
+	// Sums of all the tagged scopes, which have ended, over all threads
+	struct alloc_report
+	{
+		std::string tag;
+		size_t scopes;
+		size_t count;
+		size_t bytes;
+		size_t peak;     // the most allocations made inside one scope
+		size_t overruns; // the scopes, which went over the budget
+	};
+
+	std::vector<alloc_report> alloc_totals(); // empty, if not tracking
+	void alloc_reset_totals();
+
+	// Budgets are set per tag and checked by every scope of that tag, when
+	// it ends: a scope with more allocations than count (or more bytes than
+	// bytes) is an overrun. Overruns are counted in the totals and passed
+	// to the handler, if there is one; a test fails from there, a service
+	// could log them. Without tracking, the budgets are never checked.
+	typedef void (*alloc_overrun_handler)(const char* tag, size_t count, size_t bytes);
+
+	void alloc_set_budget(const char* tag, size_t count, size_t bytes = (size_t)-1);
+	void alloc_clear_budgets();
+	alloc_overrun_handler alloc_on_overrun(alloc_overrun_handler handler); // returns the previous one
+}
+
+#endif // __LIBWEB_ALLOC_SCOPE_HPP__
@@ -27,31 +27,191 @@
 #include <dom/dom_xpath.hpp>
 #include <dom/parsers/xml.hpp>
 #include <dom/parsers/html.hpp>
+#include <utils.hpp>
+#include <libweb/alloc_scope.hpp>
+#include "parsers/mapped_file.hpp"
 #include <vector>
 #include <iterator>
 #include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace dom {
 
-	DocumentPtr Document::fromFile(const filesystem::path& path)
+	class Reclaimer
 	{
-		auto parser = parsers::xml::create(std::string());
-		if (parser)
+		std::mutex m_guard;
+		std::condition_variable m_wakeup;
+		std::vector<DocumentPtr> m_queue;
+
+		void run()
 		{
-			auto doc = parsers::parseFile(parser, path);
-			if (doc)
-				return doc;
+			std::vector<DocumentPtr> local;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_guard);
+					m_wakeup.wait(lock, [this] { return !m_queue.empty(); });
+					local.swap(m_queue);
+				}
+
+				// documents are freed here, outside of the lock
+				local.clear();
+			}
+		}
+
+		Reclaimer()
+		{
+			std::thread([this] { run(); }).detach();
+		}
+	public:
+		static Reclaimer& instance()
+		{
+			// never destroyed, the thread outlives the static destructors
+			static Reclaimer* _this = new Reclaimer();
+			return *_this;
+		}
+
+		void push(DocumentPtr&& doc)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_guard);
+				m_queue.push_back(std::move(doc));
+			}
+			m_wakeup.notify_one();
+		}
+	};
+
+	void reclaim(DocumentPtr&& doc)
+	{
+		if (!doc)
+			return;
+
+		try
+		{
+			Reclaimer::instance().push(std::move(doc));
+		}
+		catch (std::exception&)
+		{
+			doc.reset();
+		}
+	}
+
+	namespace sniff
+	{
+		static inline bool startsWith(const std::string& text, size_t pos, const char* prefix, bool icase = false)
+		{
+			for (; *prefix; ++pos, ++prefix)
+			{
+				if (pos >= text.length())
+					return false;
+				char c = text[pos];
+				if (icase && c >= 'A' && c <= 'Z')
+					c += 'a' - 'A';
+				if (c != *prefix)
+					return false;
+			}
+			return true;
 		}
 
-		parser = parsers::html::create(std::string());
-		if (parser)
+		// The first bytes of the document, with the BOM removed and
+		// UTF-16 narrowed down to ASCII; good enough to look at markup
+		static std::string prefix(const char* data, size_t size)
+		{
+			static const size_t LENGTH = 1024;
+			auto bytes = (const unsigned char*)data;
+
+			std::string out;
+			if (size >= 2 && ((bytes[0] == 0xFE && bytes[1] == 0xFF) || (bytes[0] == 0xFF && bytes[1] == 0xFE)))
+			{
+				size_t low = bytes[0] == 0xFF ? 0 : 1;
+				for (size_t i = 2; i + 1 < size && out.length() < LENGTH; i += 2)
+					out.push_back(bytes[i + 1 - low] ? '?' : (char)bytes[i + low]);
+				return out;
+			}
+
+			if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+			{
+				data += 3;
+				size -= 3;
+			}
+
+			out.assign(data, size < LENGTH ? size : LENGTH);
+			return out;
+		}
+
+		static bool isHtml(const char* data, size_t size)
+		{
+			std::string text = prefix(data, size);
+			size_t pos = 0;
+			while (true)
+			{
+				while (pos < text.length() && isspace((unsigned char)text[pos])) ++pos;
+
+				if (pos == text.length())
+					return false;        // nothing to go on; XML first, HTML as a fallback
+				if (text[pos] != '<')
+					return true;         // text before any tag is not a valid XML
+				if (startsWith(text, pos, "<?xml"))
+					return false;
+				if (startsWith(text, pos, "<!doctype", true))
+				{
+					if (!startsWith(text, pos + 9, " html", true))
+						return false;
+
+					// XHTML doctypes are still XML documents
+					std::string doctype = text.substr(pos, text.find('>', pos) - pos);
+					std::tolower(doctype);
+					return doctype.find("xhtml") == std::string::npos;
+				}
+
+				if (startsWith(text, pos, "<!--"))
+				{
+					pos = text.find("-->", pos + 4);
+					if (pos == std::string::npos)
+						return false;
+					pos += 3;
+					continue;
+				}
+
+				return startsWith(text, pos, "<html", true);
+			}
+		}
+	}
+
+	DocumentPtr Document::fromFile(const filesystem::path& path)
+	{
+		parsers::MappedFile file;
+		if (file.open(path))
+			return fromBuffer(file.data(), file.size());
+
+		// could not map it, read it into memory instead
+		FILE* f = fopen(path.native().c_str(), "rb");
+		if (!f)
+			return nullptr;
+
+		std::vector<char> contents;
+		char buffer[8192];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			contents.insert(contents.end(), buffer, buffer + read);
+		fclose(f);
+
+		return fromBuffer(contents.data(), contents.size());
+	}
+
+	DocumentPtr Document::fromBuffer(const void* data, size_t size)
+	{
+		LIBWEB_ALLOC_SCOPE("Document::fromBuffer");
+		if (!sniff::isHtml((const char*)data, size))
 		{
-			auto doc = parsers::parseFile(parser, path);
+			auto doc = parsers::xml::parseDocument(std::string(), data, size);
 			if (doc)
 				return doc;
 		}
 
-		return nullptr;
+		return parsers::html::parseDocument(std::string(), data, size);
 	}
 
 	void Print(const NodeListPtr& subs, bool ignorews, size_t depth)
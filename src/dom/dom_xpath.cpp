@@ -25,11 +25,15 @@
 #include "pch.h"
 #include <dom/dom.hpp>
 #include <dom/dom_xpath.hpp>
+#include <libweb/alloc_scope.hpp>
 #include <vector>
 #include <string.h>
 
 namespace dom {
 	NodeListPtr createList(const std::vector<NodePtr>& list);
+	namespace impl {
+		bool selectIndexed(const DocumentPtr& doc, const std::string& name, const std::string& value, const NodePtr& scope, std::vector<NodePtr>& out);
+	};
 };
 
 namespace dom { namespace xpath {
@@ -245,29 +249,124 @@ namespace dom { namespace xpath {
 		return false;
 	}
 
+	bool Segment::accepts(const NodePtr& node)
+	{
+		for (auto&& pred : m_preds)
+		{
+			if (!pred.test(node))
+				return false;
+		}
+		return true;
+	}
+
 	void Segment::select(const NodePtr& context, std::list<NodePtr>& list)
 	{
 		std::list<NodePtr> local;
 		m_selector.select(context, local);
 		for (auto&& node: local)
 		{
-			bool add = true;
-			for (auto&& pred : m_preds)
-			{
-				if (!pred.test(node))
-				{
-					add = false;
-					break;
-				}
-			}
-			if (add)
+			if (accepts(node))
 				list.push_back(node);
 		};
 	}
 
+	// '//', or descendant-or-self::node()
+	bool Segment::descendants() const
+	{
+		return m_selector.m_axis == AXIS_DESCENDANT_OR_SELF &&
+			m_selector.m_test == TEST_NODE &&
+			m_preds.empty();
+	}
+
+	// tag[@name='value'], where the first predicate could be answered
+	// by an attribute index
+	bool Segment::indexable(std::string& name, std::string& value) const
+	{
+		if (m_selector.m_axis != AXIS_CHILD || m_selector.m_test != TEST_ELEMENT || m_preds.empty())
+			return false;
+
+		auto& pred = m_preds.front();
+		if (pred.m_type != PRED_EQUALS || pred.m_selectors.size() != 1)
+			return false;
+
+		auto& attr = pred.m_selectors.front();
+		if (attr.m_axis != AXIS_ATTRIBUTE || attr.m_test != TEST_ATTRIBUTE)
+			return false;
+
+		if (!attr.m_name.nsName.empty() || attr.m_name.localName.empty() || attr.m_name.localName == "*")
+			return false;
+
+		name = attr.m_name.localName;
+		value = pred.m_value;
+		return true;
+	}
+
+	// Every context must be the document, its fragment or an element
+	// in its tree; otherwise, the generic walk answers the query.
+	static bool selectIndexed(const std::list<NodePtr>& contexts, Segment& seg, const std::string& name, const std::string& value, std::list<NodePtr>& list)
+	{
+		DocumentPtr doc;
+		for (auto&& ctx : contexts)
+		{
+			if (!ctx)
+				return false;
+			auto owner = ctx->ownerDocument();
+			if (!owner || (doc && doc != owner))
+				return false;
+			doc = owner;
+		}
+
+		std::vector<NodePtr> candidates;
+		for (auto&& ctx : contexts)
+		{
+			if (!impl::selectIndexed(doc, name, value, ctx, candidates))
+				return false;
+		}
+
+		for (auto&& node : candidates)
+		{
+			NodePtr test = node;
+			if (seg.m_selector.passable(test) && seg.accepts(node))
+				list.push_back(node);
+		}
+
+		return true;
+	}
+
+	std::list<NodePtr> XPath::select(const NodePtr& context)
+	{
+		std::list<NodePtr> parent;
+		parent.push_back(context);
+
+		auto from = m_segments.begin();
+		auto to = m_segments.end();
+		while (from != to)
+		{
+			std::list<NodePtr> list;
+
+			std::string name, value;
+			auto next = std::next(from);
+			if (next != to && from->descendants() && next->indexable(name, value) &&
+				selectIndexed(parent, *next, name, value, list))
+			{
+				from = next;
+			}
+			else
+			{
+				for (auto&& ctx : parent)
+					from->select(ctx, list);
+			}
+
+			parent.swap(list);
+			++from;
+		}
+		return parent;
+	}
+
 	NodePtr XPath::find(const NodePtr& context)
 	{
-		std::list<NodePtr> list = select(m_segments.begin(), m_segments.end(), context);
+		LIBWEB_ALLOC_SCOPE("XPath::find");
+		std::list<NodePtr> list = select(context);
 		if (list.size())
 			return *list.begin();
 		return nullptr;
@@ -275,7 +374,8 @@ namespace dom { namespace xpath {
 
 	NodeListPtr XPath::findall(const NodePtr& context)
 	{
-		std::list<NodePtr> list = select(m_segments.begin(), m_segments.end(), context);
+		LIBWEB_ALLOC_SCOPE("XPath::findall");
+		std::list<NodePtr> list = select(context);
 		if (list.size())
 		{
 			std::vector<NodePtr> nodes(list.begin(), list.end());
@@ -32,7 +32,25 @@ namespace dom { namespace impl {
 	class Attribute : public NodeImpl<Attribute, dom::Attribute>
 	{
 	public:
-		Attribute(const Init& init) : NodeImpl(init) {}
+		Attribute(Init&& init) : NodeImpl(std::move(init)) {}
+
+		void nodeValue(const std::string& val) override
+		{
+			nodeValue(std::string(val));
+		}
+
+		void nodeValue(std::string&& val) override
+		{
+			auto elem = parent.lock();
+			auto doc = document.lock();
+
+			NodeValue old;
+			old.swap(_value);
+			_value.assign(std::move(val));
+
+			if (elem && doc)
+				std::static_pointer_cast<impl::Document>(doc)->attributeChanged(elem.get(), _name, &old.get(), &_value.get());
+		}
 
 		dom::NodePtr previousSibling() override
 		{
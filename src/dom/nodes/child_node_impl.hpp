@@ -35,7 +35,7 @@ namespace dom { namespace impl {
 	public:
 
 		typedef NodeImpl<T, _Interface> Super;
-		ChildNodeImpl(const NodeImplInit& init) : Super(init)
+		ChildNodeImpl(NodeImplInit&& init) : Super(std::move(init))
 		{
 		}
 
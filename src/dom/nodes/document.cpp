@@ -32,6 +32,8 @@
 namespace dom { namespace impl {
 
 	Document::Document()
+		: poolTextLength(0)
+		, ordered(false)
 	{
 		m_qname.localName = "#document";
 	}
@@ -54,28 +56,54 @@ namespace dom { namespace impl {
 
 	void Document::setDocumentElement(const dom::ElementPtr& elem)
 	{
+		detachTree();
 		root = elem;
-		fragment = nullptr;
 		if (elem)
+		{
 			((NodeImplInit*)elem->internalData())->fixQName();
+			attachSubtree(elem, true);
+		}
 	}
 
 	void Document::setFragment(const DocumentFragmentPtr& f)
 	{
-		root = nullptr;
+		detachTree();
 		fragment = f;
 		if (f)
+		{
 			((NodeImplInit*)f->internalData())->fixQName();
+			attachSubtree(f, true);
+		}
+	}
+
+	void Document::detachTree()
+	{
+		ordered = false;
+		for (auto&& pair : indexes)
+			pair.second.clear();
+
+		if (root)
+			attachSubtree(root, false);
+		if (fragment)
+			attachSubtree(fragment, false);
+		root = nullptr;
+		fragment = nullptr;
 	}
+
 	dom::ElementPtr Document::createElement(const std::string& tagName)
+	{
+		return createElement(std::string(tagName));
+	}
+
+	dom::ElementPtr Document::createElement(std::string&& tagName)
 	{
 		NodeImplInit init;
 		init.type = ELEMENT_NODE;
-		init._name = tagName;
+		init._name = std::move(tagName);
 		//init._value;
 		init.document = shared_from_this();
 		init.index = 0;
-		return std::make_shared<Element>(init);
+		return std::make_shared<Element>(std::move(init));
 	}
 
 	dom::TextPtr Document::createTextNode(const std::string& data)
@@ -83,10 +111,27 @@ namespace dom { namespace impl {
 		NodeImplInit init;
 		init.type = TEXT_NODE;
 		//init._name;
-		init._value = data;
+		if (pool && data.length() <= poolTextLength)
+			init._value.share(pool->intern(data));
+		else
+			init._value.assign(data);
 		init.document = shared_from_this();
 		init.index = 0;
-		return std::make_shared<Text>(init);
+		return std::make_shared<Text>(std::move(init));
+	}
+
+	dom::TextPtr Document::createTextNode(std::string&& data)
+	{
+		NodeImplInit init;
+		init.type = TEXT_NODE;
+		//init._name;
+		if (pool && data.length() <= poolTextLength)
+			init._value.share(pool->intern(std::move(data)));
+		else
+			init._value.assign(std::move(data));
+		init.document = shared_from_this();
+		init.index = 0;
+		return std::make_shared<Text>(std::move(init));
 	}
 
 	dom::AttributePtr Document::createAttribute(const std::string& name, const std::string& value)
@@ -94,10 +139,61 @@ namespace dom { namespace impl {
 		NodeImplInit init;
 		init.type = ATTRIBUTE_NODE;
 		init._name = name;
-		init._value = value;
+		if (pool)
+			init._value.share(pool->intern(value));
+		else
+			init._value.assign(value);
+		init.document = shared_from_this();
+		init.index = 0;
+		return std::make_shared<Attribute>(std::move(init));
+	}
+
+	dom::AttributePtr Document::createAttribute(std::string&& name, std::string&& value)
+	{
+		NodeImplInit init;
+		init.type = ATTRIBUTE_NODE;
+		init._name = std::move(name);
+		if (pool)
+			init._value.share(pool->intern(std::move(value)));
+		else
+			init._value.assign(std::move(value));
+		init.document = shared_from_this();
+		init.index = 0;
+		return std::make_shared<Attribute>(std::move(init));
+	}
+
+	static inline void setQName(NodeImplInit& init, const std::string& ns)
+	{
+		std::string::size_type col = init._name.find(':');
+		init.qname.nsName = ns;
+		init.qname.localName = col == std::string::npos ? init._name : init._name.substr(col + 1);
+		init.qnameFixed = true;
+	}
+
+	dom::ElementPtr Document::createElementNS(const std::string& ns, const std::string& qualifiedName)
+	{
+		NodeImplInit init;
+		init.type = ELEMENT_NODE;
+		init._name = qualifiedName;
+		setQName(init, ns);
+		init.document = shared_from_this();
+		init.index = 0;
+		return std::make_shared<Element>(std::move(init));
+	}
+
+	dom::AttributePtr Document::createAttributeNS(const std::string& ns, const std::string& qualifiedName, const std::string& value)
+	{
+		NodeImplInit init;
+		init.type = ATTRIBUTE_NODE;
+		init._name = qualifiedName;
+		setQName(init, ns);
+		if (pool)
+			init._value.share(pool->intern(value));
+		else
+			init._value.assign(value);
 		init.document = shared_from_this();
 		init.index = 0;
-		return std::make_shared<Attribute>(init);
+		return std::make_shared<Attribute>(std::move(init));
 	}
 
 	dom::DocumentFragmentPtr Document::createDocumentFragment()
@@ -107,7 +203,62 @@ namespace dom { namespace impl {
 		init._name = "#document-fragment";
 		init.document = shared_from_this();
 		init.index = 0;
-		return std::make_shared<DocumentFragment>(init);
+		return std::make_shared<DocumentFragment>(std::move(init));
+	}
+
+	bool Document::adoptNode(const NodePtr& node)
+	{
+		if (!node)
+			return false;
+
+		NodeImplInit* root = (NodeImplInit*)node->internalData();
+		if (!root)
+			return false;
+
+		auto self = shared_from_this();
+		auto previous = root->document.lock();
+		if (previous == self)
+			return true;
+
+		if (!removeFromParent(node))
+			return false;
+
+		if (previous)
+		{
+			if (previous->documentElement() == node)
+				previous->setDocumentElement(nullptr);
+			else if (previous->associatedFragment() == node)
+				previous->setFragment(nullptr);
+		}
+
+		std::vector<NodeImplInit*> pending;
+		pending.push_back(root);
+		while (!pending.empty())
+		{
+			auto current = pending.back();
+			pending.pop_back();
+			if (current)
+				current->adopt(self, pending);
+		}
+
+		return true;
+	}
+
+	void Document::enableStringPool(size_t maxTextLength)
+	{
+		if (!pool)
+			pool.reset(new (std::nothrow) StringPool());
+		poolTextLength = maxTextLength;
+	}
+
+	StringPoolStats Document::stringPoolStats()
+	{
+		if (!pool)
+		{
+			StringPoolStats empty = { 0, 0, 0 };
+			return empty;
+		}
+		return pool->stats();
 	}
 
 	dom::NodeListPtr Document::getElementsByTagName(const std::string& tagName)
@@ -124,6 +275,363 @@ namespace dom { namespace impl {
 		return nullptr;
 	}
 
+	bool Document::isAttached(dom::Node* node)
+	{
+		NodeImplInit* p = node ? (NodeImplInit*)node->internalData() : nullptr;
+		return p && p->attached;
+	}
+
+	void Document::indexValue(dom::Node* node, AttributeIndex& index, const std::string& value, bool add)
+	{
+		Element* elem = (Element*)node;
+		if (add)
+		{
+			auto& bucket = index[value];
+			if (!bucket.elements.empty())
+				bucket.sorted = false;
+			bucket.elements.push_back(elem);
+			return;
+		}
+
+		auto it = index.find(value);
+		if (it == index.end())
+			return;
+
+		auto& elements = it->second.elements;
+		auto pos = std::find(elements.begin(), elements.end(), elem);
+		if (pos == elements.end())
+			return;
+
+		if (pos + 1 != elements.end())
+		{
+			*pos = elements.back();
+			it->second.sorted = false;
+		}
+		elements.pop_back();
+
+		if (elements.empty())
+			index.erase(it);
+	}
+
+	void Document::attachNode(dom::Node* node, NodeImplInit* p, bool attach)
+	{
+		p->attached = attach;
+		if (indexes.empty() || node->nodeType() != ELEMENT_NODE)
+			return;
+
+		auto elem = (Element*)node;
+		for (auto&& pair : indexes)
+		{
+			auto attr = elem->getAttributeNode(pair.first);
+			if (attr)
+				indexValue(elem, pair.second, attr->value(), attach);
+		}
+	}
+
+	void Document::attachSubtree(const NodePtr& node, bool attach)
+	{
+		NodeImplInit* p = (NodeImplInit*)node->internalData();
+		if (!p)
+			return;
+
+		// the parsers insert one childless node at a time
+		if (p->children.empty())
+		{
+			attachNode(node.get(), p, attach);
+			return;
+		}
+
+		std::vector<dom::Node*> pending;
+		pending.push_back(node.get());
+		while (!pending.empty())
+		{
+			auto current = pending.back();
+			pending.pop_back();
+
+			p = (NodeImplInit*)current->internalData();
+			if (!p)
+				continue;
+
+			attachNode(current, p, attach);
+			for (auto&& child : p->children)
+				pending.push_back(child.get());
+		}
+	}
+
+	void Document::rebuildIndexes()
+	{
+		for (auto&& pair : indexes)
+			pair.second.clear();
+
+		if (root)
+			attachSubtree(root, true);
+		if (fragment)
+			attachSubtree(fragment, true);
+	}
+
+	bool Document::indexAttribute(const std::string& name)
+	{
+		if (indexes.find(name) != indexes.end())
+			return true;
+
+		indexes[name];
+		rebuildIndexes();
+		return true;
+	}
+
+	bool Document::hasAttributeIndex(const std::string& name)
+	{
+		return indexes.find(name) != indexes.end();
+	}
+
+	// One pre-order walk; the subtree of an element gets the numbers
+	// from its own order + 1 up to its orderEnd. The same walk lists the
+	// elements the way the XPath's descendant axis does: the children of
+	// a node together, when the walk enters that node. The //tag then
+	// takes the children of the listed nodes in that order; the ranks.
+	void Document::numberElements()
+	{
+		struct Frame
+		{
+			Element* elem;
+			NodeImplInit* node;
+			size_t next;
+		};
+		std::vector<Frame> stack;
+		std::vector<NodeImplInit*> listed;
+		size_t counter = 0;
+
+		auto enter = [&](dom::Node* node) {
+			Frame frame = { nullptr, (NodeImplInit*)node->internalData(), 0 };
+			if (node->nodeType() == ELEMENT_NODE)
+			{
+				frame.elem = (Element*)node;
+				frame.elem->order = ++counter;
+			}
+			if (frame.node)
+			{
+				for (auto&& child : frame.node->children)
+				{
+					if (child->nodeType() == ELEMENT_NODE)
+						listed.push_back((NodeImplInit*)child->internalData());
+				}
+			}
+			stack.push_back(frame);
+		};
+
+		if (root)
+			listed.push_back((NodeImplInit*)root->internalData());
+
+		dom::Node* tops[] = { root.get(), fragment.get() };
+		for (auto top : tops)
+		{
+			if (!top)
+				continue;
+
+			enter(top);
+			while (!stack.empty())
+			{
+				auto& frame = stack.back();
+				if (frame.node && frame.next < frame.node->children.size())
+				{
+					enter(frame.node->children[frame.next++].get());
+					continue;
+				}
+
+				if (frame.elem)
+					frame.elem->orderEnd = counter;
+				stack.pop_back();
+			}
+		}
+
+		size_t rank = 0;
+		auto rankChildren = [&](NodeImplInit* node) {
+			for (auto&& child : node->children)
+			{
+				if (child->nodeType() == ELEMENT_NODE)
+					((Element*)child.get())->rank = ++rank;
+			}
+		};
+
+		// the document lists its element, or the children of its fragment
+		if (root)
+			((Element*)root.get())->rank = ++rank;
+		if (fragment)
+			rankChildren((NodeImplInit*)fragment->internalData());
+		for (auto node : listed)
+			rankChildren(node);
+
+		ordered = true;
+	}
+
+	bool Document::isScope(const NodePtr& scope, bool& everything)
+	{
+		if (!scope)
+			return false;
+
+		// the root or the fragment holds the whole tree
+		everything = scope.get() == static_cast<dom::Node*>(this) || (fragment && scope.get() == fragment.get());
+		if (everything)
+			return true;
+
+		return scope->nodeType() == ELEMENT_NODE && isAttached(scope.get()) &&
+			scope->ownerDocument().get() == static_cast<dom::Document*>(this);
+	}
+
+	void Document::scopedRun(Bucket& bucket, const NodePtr& scope, bool everything, std::vector<Element*>::iterator& from, std::vector<Element*>::iterator& to)
+	{
+		if ((!bucket.sorted || !everything) && !ordered)
+			numberElements();
+
+		if (!bucket.sorted)
+		{
+			std::sort(bucket.elements.begin(), bucket.elements.end(), [](Element* lhs, Element* rhs) { return lhs->order < rhs->order; });
+			bucket.sorted = true;
+		}
+
+		from = bucket.elements.begin();
+		to = bucket.elements.end();
+		if (!everything)
+		{
+			// the subtree of the scope is a single run of the sorted bucket
+			auto elem = (Element*)scope.get();
+			auto before = [](size_t order, Element* elem) { return order < elem->order; };
+			from = std::upper_bound(from, to, elem->order, before);
+			to = std::upper_bound(from, to, elem->orderEnd, before);
+		}
+	}
+
+	dom::NodeListPtr Document::getElementsByAttribute(const std::string& name, const std::string& value)
+	{
+		return getElementsByAttribute(name, value, shared_from_this());
+	}
+
+	dom::NodeListPtr Document::getElementsByAttribute(const std::string& name, const std::string& value, const NodePtr& scope)
+	{
+		NodePtrs out;
+		bool everything = false;
+		if (!isScope(scope, everything))
+			return std::make_shared<NodeList>(out);
+
+		auto index = indexes.find(name);
+		if (index == indexes.end())
+		{
+			NodePtrs pending;
+			if (everything)
+			{
+				if (root)
+					pending.push_back(root);
+				if (fragment)
+					pending.push_back(fragment);
+			}
+			else
+			{
+				NodeImplInit* p = (NodeImplInit*)scope->internalData();
+				pending.insert(pending.end(), p->children.rbegin(), p->children.rend());
+			}
+
+			while (!pending.empty())
+			{
+				auto current = pending.back();
+				pending.pop_back();
+
+				if (current->nodeType() == ELEMENT_NODE)
+				{
+					auto attr = ((Element*)current.get())->getAttributeNode(name);
+					if (attr && attr->value() == value)
+						out.push_back(current);
+				}
+
+				NodeImplInit* p = (NodeImplInit*)current->internalData();
+				if (p)
+					pending.insert(pending.end(), p->children.rbegin(), p->children.rend());
+			}
+
+			return std::make_shared<NodeList>(out);
+		}
+
+		auto it = index->second.find(value);
+		if (it == index->second.end())
+			return std::make_shared<NodeList>(out);
+
+		std::vector<Element*>::iterator from, to;
+		scopedRun(it->second, scope, everything, from, to);
+
+		out.reserve(to - from);
+		for (; from != to; ++from)
+			out.push_back((*from)->shared_from_this());
+
+		return std::make_shared<NodeList>(out);
+	}
+
+	// The //tag[@name='value'] of the XPath; false, if the index cannot
+	// tell, what the generic walk would find below the scope.
+	bool Document::selectIndexed(const std::string& name, const std::string& value, const NodePtr& scope, NodePtrs& out)
+	{
+		bool everything = false;
+		if (!isScope(scope, everything))
+			return false;
+
+		auto index = indexes.find(name);
+		if (index == indexes.end())
+			return false;
+
+		auto it = index->second.find(value);
+		if (it == index->second.end())
+			return true;
+
+		if (!ordered)
+			numberElements();
+
+		std::vector<Element*>::iterator from, to;
+		scopedRun(it->second, scope, everything, from, to);
+
+		std::vector<Element*> run(from, to);
+		std::sort(run.begin(), run.end(), [](Element* lhs, Element* rhs) { return lhs->rank < rhs->rank; });
+
+		out.reserve(out.size() + run.size());
+		for (auto elem : run)
+			out.push_back(elem->shared_from_this());
+		return true;
+	}
+
+	bool selectIndexed(const dom::DocumentPtr& doc, const std::string& name, const std::string& value, const NodePtr& scope, NodePtrs& out)
+	{
+		// only this document keeps the attribute indexes
+		if (!doc || !doc->hasAttributeIndex(name))
+			return false;
+		return std::static_pointer_cast<Document>(doc)->selectIndexed(name, value, scope, out);
+	}
+
+	void Document::nodeInserted(const NodePtr& node)
+	{
+		ordered = false;
+		if (node)
+			attachSubtree(node, true);
+	}
+
+	void Document::nodeRemoved(const NodePtr& node)
+	{
+		ordered = false;
+		if (node)
+			attachSubtree(node, false);
+	}
+
+	void Document::attributeChanged(dom::Node* elem, const std::string& name, const std::string* oldValue, const std::string* newValue)
+	{
+		if (indexes.empty())
+			return;
+
+		auto index = indexes.find(name);
+		if (index == indexes.end() || !isAttached(elem))
+			return;
+
+		if (oldValue)
+			indexValue(elem, index->second, *oldValue, false);
+		if (newValue)
+			indexValue(elem, index->second, *newValue, true);
+	}
+
 	NodePtr Document::find(const std::string& path, const Namespaces& ns)
 	{
 		return xpath::XPath(path, ns).find(shared_from_this());
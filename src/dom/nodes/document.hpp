@@ -26,14 +26,42 @@
 #define __DOM_INTERNAL_DOCUMENT_HPP__
 
 #include <dom/nodes/document.hpp>
+#include <vector>
+#include <map>
+#include "string_pool.hpp"
 
 namespace dom { namespace impl {
 
+	class Element;
+	struct NodeImplInit;
+
 	class Document : public dom::Document, public std::enable_shared_from_this<Document>
 	{
+		struct Bucket
+		{
+			std::vector<Element*> elements;
+			bool sorted;
+			Bucket() : sorted(true) {}
+		};
+		using AttributeIndex = std::map<std::string, Bucket>;
+
 		QName m_qname;
 		dom::ElementPtr root;
 		dom::DocumentFragmentPtr fragment;
+		std::map<std::string, AttributeIndex> indexes;
+		std::unique_ptr<StringPool> pool;
+		size_t poolTextLength;
+		bool ordered; // the elements' order fields match the tree
+
+		bool isAttached(dom::Node* node);
+		bool isScope(const NodePtr& scope, bool& everything);
+		void numberElements();
+		void scopedRun(Bucket& bucket, const NodePtr& scope, bool everything, std::vector<Element*>::iterator& from, std::vector<Element*>::iterator& to);
+		void indexValue(dom::Node* elem, AttributeIndex& index, const std::string& value, bool add);
+		void attachNode(dom::Node* node, NodeImplInit* p, bool attach);
+		void attachSubtree(const NodePtr& node, bool attach);
+		void detachTree();
+		void rebuildIndexes();
 	public:
 		Document();
 
@@ -41,6 +69,9 @@ namespace dom { namespace impl {
 		const QName& nodeQName() const override { return m_qname; }
 		std::string nodeValue() const override { return std::string(); }
 		void nodeValue(const std::string&) override {}
+		void nodeValue(std::string&&) override {}
+		string_view nodeNameView() const override { return m_qname.localName; }
+		string_view nodeValueView() const override { return string_view(); }
 		NODE_TYPE nodeType() const override { return DOCUMENT_NODE; }
 
 		NodePtr parentNode() override { return nullptr; }
@@ -63,11 +94,28 @@ namespace dom { namespace impl {
 		dom::DocumentFragmentPtr associatedFragment() override { return fragment; }
 		void setFragment(const DocumentFragmentPtr& f) override;
 		dom::ElementPtr createElement(const std::string& tagName) override;
+		dom::ElementPtr createElement(std::string&& tagName) override;
 		dom::TextPtr createTextNode(const std::string& data) override;
+		dom::TextPtr createTextNode(std::string&& data) override;
 		dom::AttributePtr createAttribute(const std::string& name, const std::string& value) override;
+		dom::AttributePtr createAttribute(std::string&& name, std::string&& value) override;
+		dom::ElementPtr createElementNS(const std::string& ns, const std::string& qualifiedName) override;
+		dom::AttributePtr createAttributeNS(const std::string& ns, const std::string& qualifiedName, const std::string& value) override;
 		dom::DocumentFragmentPtr createDocumentFragment() override;
+		bool adoptNode(const NodePtr& node) override;
 		dom::NodeListPtr getElementsByTagName(const std::string& tagName) override;
 		dom::ElementPtr getElementById(const std::string& elementId) override;
+		bool indexAttribute(const std::string& name) override;
+		bool hasAttributeIndex(const std::string& name) override;
+		dom::NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value) override;
+		dom::NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value, const NodePtr& scope) override;
+		void enableStringPool(size_t maxTextLength) override;
+		StringPoolStats stringPoolStats() override;
+
+		void nodeInserted(const NodePtr& node);
+		void nodeRemoved(const NodePtr& node);
+		void attributeChanged(dom::Node* elem, const std::string& name, const std::string* oldValue, const std::string* newValue);
+		bool selectIndexed(const std::string& name, const std::string& value, const NodePtr& scope, NodePtrs& out);
 		NodePtr find(const std::string& path, const Namespaces& ns) override;
 		NodeListPtr findall(const std::string& path, const Namespaces& ns) override;
 	};
@@ -28,7 +28,7 @@
 
 namespace dom { namespace impl {
 
-	DocumentFragment::DocumentFragment(const Init& init) : ParentNodeImpl(init) {}
+	DocumentFragment::DocumentFragment(Init&& init) : ParentNodeImpl(std::move(init)) {}
 
 	void DocumentFragment::enumTagNames(const std::string& tagName, NodePtrs& out)
 	{
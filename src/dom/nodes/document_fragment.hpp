@@ -34,7 +34,7 @@ namespace dom { namespace impl {
 		void enumTagNames(const std::string& tagName, NodePtrs& out);
 
 	public:
-		DocumentFragment(const Init& init);
+		DocumentFragment(Init&& init);
 		dom::NodeListPtr getElementsByTagName(const std::string& tagName) override;
 	};
 }}
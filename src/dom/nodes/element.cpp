@@ -28,7 +28,7 @@
 
 namespace dom { namespace impl {
 
-	Element::Element(const Init& init) : ParentNodeImpl(init), nsRebuilt(false) {}
+	Element::Element(Init&& init) : ParentNodeImpl(std::move(init)), nsRebuilt(false) {}
 
 	std::string Element::getAttribute(const std::string& name)
 	{
@@ -38,6 +38,14 @@ namespace dom { namespace impl {
 		return _it->second->value();
 	}
 
+	string_view Element::getAttributeView(const std::string& name)
+	{
+		std::map< std::string, dom::AttributePtr >::const_iterator
+			_it = lookup.find(name);
+		if (_it == lookup.end()) return string_view();
+		return _it->second->nodeValueView();
+	}
+
 	dom::AttributePtr Element::getAttributeNode(const std::string& name)
 	{
 		std::map< std::string, dom::AttributePtr >::const_iterator
@@ -60,6 +68,7 @@ namespace dom { namespace impl {
 			return true;
 		}
 		lookup[attr->name()] = attr;
+		notifyAttribute(attr->name(), nullptr, attr);
 		return true;
 	}
 
@@ -71,11 +80,16 @@ namespace dom { namespace impl {
 	}
 
 	bool Element::setAttribute(const std::string& attr, const std::string& value)
+	{
+		return Element::setAttribute(std::string(attr), std::string(value));
+	}
+
+	bool Element::setAttribute(std::string&& attr, std::string&& value)
 	{
 		auto doc = Element::ownerDocument();
 		if (!doc)
 			return false;
-		auto attribute = doc->createAttribute(attr, value);
+		auto attribute = doc->createAttribute(std::move(attr), std::move(value));
 		if (!attribute)
 			return false;
 
@@ -87,10 +101,32 @@ namespace dom { namespace impl {
 		auto it = lookup.find(attr);
 		if (it == lookup.end())
 			return false;
+
+		auto old = it->second;
+		NodeImplInit* p = (NodeImplInit*)old->internalData();
+		if (p)
+			p->parent.reset();
+
 		lookup.erase(it);
+		notifyAttribute(attr, old, nullptr);
 		return true;
 	}
 
+	void Element::notifyAttribute(const std::string& name, const dom::AttributePtr& removed, const dom::AttributePtr& added)
+	{
+		auto doc = std::static_pointer_cast<impl::Document>(document.lock());
+		if (!doc || !doc->hasAttributeIndex(name))
+			return;
+
+		std::string oldValue, newValue;
+		if (removed)
+			oldValue = removed->value();
+		if (added)
+			newValue = added->value();
+
+		doc->attributeChanged(this, name, removed ? &oldValue : nullptr, added ? &newValue : nullptr);
+	}
+
 	struct get_1 {
 		template<typename K, typename V>
 		const V& operator()(const std::pair<K, V>& _item) { return _item.second; }
@@ -104,6 +140,12 @@ namespace dom { namespace impl {
 		return std::make_shared<NodeList>(out);
 	}
 
+	void Element::visitAttributes(AttributeVisitor& visitor)
+	{
+		for (auto&& pair : lookup)
+			visitor.onAttribute(pair.second->nodeNameView(), pair.second->nodeValueView());
+	}
+
 	bool Element::hasAttribute(const std::string& name)
 	{
 		std::map< std::string, dom::AttributePtr >::const_iterator
@@ -205,4 +247,18 @@ namespace dom { namespace impl {
 		}
 		NodeImpl<Element, dom::Element>::fixQName(qname, ns, localName);
 	}
+
+	void Element::adopt(const std::shared_ptr<dom::Document>& doc, std::vector<NodeImplInit*>& pending)
+	{
+		NodeImplInit::adopt(doc, pending);
+		for (auto&& pair : lookup)
+		{
+			NodeImplInit* p = (NodeImplInit*)pair.second->internalData();
+			if (p)
+				p->document = doc;
+		}
+
+		nsRebuilt = false;
+		fixQName();
+	}
 }}
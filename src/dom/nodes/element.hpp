@@ -35,16 +35,21 @@ namespace dom { namespace impl {
 		InternalNamespaces namespaces;
 		std::map< std::string, dom::AttributePtr > lookup;
 		bool nsRebuilt;
+
+		void notifyAttribute(const std::string& name, const dom::AttributePtr& removed, const dom::AttributePtr& added);
 	public:
-		Element(const Init& init);
+		Element(Init&& init);
 
 		std::string getAttribute(const std::string& name) override;
+		string_view getAttributeView(const std::string& name) override;
 		dom::AttributePtr getAttributeNode(const std::string& name) override;
 		bool setAttribute(const dom::AttributePtr& attr) override;
 		bool removeAttribute(const AttributePtr& attr) override;
 		bool setAttribute(const std::string& attr, const std::string& value) override;
+		bool setAttribute(std::string&& attr, std::string&& value) override;
 		bool removeAttribute(const std::string& attr) override;
 		dom::NodeListPtr getAttributes() override;
+		void visitAttributes(AttributeVisitor& visitor) override;
 		bool hasAttribute(const std::string& name) override;
 		void enumTagNames(const std::string& tagName, NodePtrs& out);
 		dom::NodeListPtr getElementsByTagName(const std::string& tagName) override;
@@ -53,6 +58,14 @@ namespace dom { namespace impl {
 		std::string innerText() override;
 		void fixQName(bool forElem = true) override;
 		void fixQName(QName& qname, const std::string& ns, const std::string& localName) override;
+		void adopt(const std::shared_ptr<dom::Document>& doc, std::vector<NodeImplInit*>& pending) override;
+
+		// position in the document order and the last position inside
+		// this element, and the position, in which the XPath's //tag lists
+		// this element; kept by Document::numberElements
+		size_t order = 0;
+		size_t orderEnd = 0;
+		size_t rank = 0;
 	};
 }}
 
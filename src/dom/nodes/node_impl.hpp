@@ -28,6 +28,8 @@
 #include <dom/dom.hpp>
 #include <dom/dom_xpath.hpp>
 #include "nodelist.hpp"
+#include "document.hpp"
+#include "string_pool.hpp"
 
 namespace dom { namespace impl {
 
@@ -52,15 +54,52 @@ namespace dom { namespace impl {
 	struct NodeImplInit
 	{
 		NODE_TYPE type;
-		std::string _name, _value;
+		std::string _name;
+		NodeValue _value;
 		NodePtrs children;
 		std::weak_ptr<dom::Document> document;
 		std::weak_ptr<dom::Node> parent;
 		size_t index = (size_t)-1;
 		QName qname;
+		bool qnameFixed = false; // set by the createXxxNS, no need to resolve the prefix
+		bool attached = false; // in the tree of the document; kept by the impl::Document
+
+		NodeImplInit() = default;
+		NodeImplInit(const NodeImplInit&) = default;
+		NodeImplInit(NodeImplInit&&) = default;
+		NodeImplInit& operator=(const NodeImplInit&) = default;
+		NodeImplInit& operator=(NodeImplInit&&) = default;
+
+		// Releasing the children one by one would recurse as deep as the
+		// tree goes; instead, the nodes destroyed inside the outermost
+		// destructor on this thread leave their children to its flat list.
+		// Only the children of an expired node are taken, so a thread still
+		// holding a descendant can never see a parent's list change: the
+		// parent is either alive and untouched, or gone for good.
+		virtual ~NodeImplInit()
+		{
+			static thread_local NodePtrs* graveyard = nullptr;
+			if (graveyard)
+			{
+				std::move(children.begin(), children.end(), std::back_inserter(*graveyard));
+				return;
+			}
+
+			NodePtrs pending;
+			pending.swap(children);
+			graveyard = &pending;
+			while (!pending.empty())
+			{
+				NodePtr node = std::move(pending.back());
+				pending.pop_back();
+				node.reset(); // may add its children to the pending
+			}
+			graveyard = nullptr;
+		}
 
 		virtual void fixQName(bool forElem = true)
 		{
+			if (qnameFixed) return;
 			std::string::size_type col = _name.find(':');
 			if (col == std::string::npos && !forElem) return;
 			if (col == std::string::npos)
@@ -77,6 +116,16 @@ namespace dom { namespace impl {
 			if (!p) return;
 			p->fixQName(qname, ns, localName);
 		}
+
+		// Moves this node to the new document; the children are
+		// queued to the pending list, so that the caller may walk
+		// any depth of subtree without recursion.
+		virtual void adopt(const std::shared_ptr<dom::Document>& doc, std::vector<NodeImplInit*>& pending)
+		{
+			document = doc;
+			for (auto&& child : children)
+				pending.push_back((NodeImplInit*)child->internalData());
+		}
 	};
 
 	template <typename T, typename _Interface>
@@ -87,19 +136,27 @@ namespace dom { namespace impl {
 		typedef NodeImplInit Init;
 		typedef _Interface Interface;
 
-		NodeImpl(const Init& init) : Init(init)
+		NodeImpl(Init&& init) : Init(std::move(init))
 		{
-			qname.localName = init._name;
+			if (!qnameFixed)
+				qname.localName = _name;
 		}
 
 		std::string nodeName() const override { return _name; }
 		const QName& nodeQName() const override { return qname; }
-		std::string nodeValue() const override { return _value; }
+		std::string nodeValue() const override { return _value.get(); }
 		void nodeValue(const std::string& val) override
 		{
 			if (type != ELEMENT_NODE)
-				_value = val;
+				_value.assign(val);
+		}
+		void nodeValue(std::string&& val) override
+		{
+			if (type != ELEMENT_NODE)
+				_value.assign(std::move(val));
 		}
+		string_view nodeNameView() const override { return _name; }
+		string_view nodeValueView() const override { return _value.get(); }
 
 		NODE_TYPE nodeType() const override { return type; }
 
@@ -152,6 +209,26 @@ namespace dom { namespace impl {
 
 		dom::DocumentPtr ownerDocument() override { return document.lock(); }
 
+		// the document follows its own tree only; the subtrees built
+		// aside reach it, when they are inserted into that tree
+		void nodeInserted(const NodePtr& node)
+		{
+			if (!attached)
+				return;
+			auto doc = document.lock();
+			if (doc)
+				std::static_pointer_cast<impl::Document>(doc)->nodeInserted(node);
+		}
+
+		void nodeRemoved(const NodePtr& node)
+		{
+			if (!attached)
+				return;
+			auto doc = document.lock();
+			if (doc)
+				std::static_pointer_cast<impl::Document>(doc)->nodeRemoved(node);
+		}
+
 		size_t indexOf(const NodePtr& node)
 		{
 			if (!node)
@@ -195,6 +272,7 @@ namespace dom { namespace impl {
 				p->index = i;
 			}
 
+			nodeInserted(newChild);
 			return true;
 		}
 		bool insertBefore(const NodeListPtr& children, const NodePtr& before = nullptr) override
@@ -253,6 +331,12 @@ namespace dom { namespace impl {
 				p->index = i;
 			}
 
+			for (auto&& node : copy)
+			{
+				if (node->nodeType() != ATTRIBUTE_NODE)
+					nodeInserted(node);
+			}
+
 			return true;
 		}
 
@@ -293,6 +377,8 @@ namespace dom { namespace impl {
 			if (index >= children.size())
 				return false;
 
+			nodeRemoved(child);
+
 			NodeImplInit* p = (NodeImplInit*)child->internalData();
 			p->parent.reset();
 			p->index = (size_t)-1;
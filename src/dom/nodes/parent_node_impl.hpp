@@ -34,7 +34,7 @@ namespace dom { namespace impl {
 	{
 	public:
 		typedef ChildNodeImpl<T, _Interface> Super;
-		ParentNodeImpl(const NodeImplInit& init) : Super(init)
+		ParentNodeImpl(NodeImplInit&& init) : Super(std::move(init))
 		{
 		}
 
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_STRING_POOL_HPP__
+#define __DOM_INTERNAL_STRING_POOL_HPP__
+
+#include <dom/nodes/document.hpp>
+#include <unordered_set>
+#include <string>
+
+namespace dom { namespace impl {
+
+	using SharedString = std::shared_ptr<const std::string>;
+
+	// Value of a text or an attribute node. It may point to a string
+	// shared through the document's pool; any change detaches the node
+	// from the shared copy first.
+	class NodeValue
+	{
+		SharedString m_shared;
+		std::string m_own;
+	public:
+		const std::string& get() const { return m_shared ? *m_shared : m_own; }
+		void assign(const std::string& value) { m_shared.reset(); m_own = value; }
+		void assign(std::string&& value) { m_shared.reset(); m_own = std::move(value); }
+		void share(const SharedString& value) { m_shared = value; m_own.clear(); }
+		void swap(NodeValue& other) { m_shared.swap(other.m_shared); m_own.swap(other.m_own); }
+	};
+
+	class StringPool
+	{
+		struct Hash
+		{
+			size_t operator()(const SharedString& s) const { return std::hash<std::string>()(*s); }
+		};
+		struct Equal
+		{
+			bool operator()(const SharedString& lhs, const SharedString& rhs) const { return *lhs == *rhs; }
+		};
+		enum { MIN_SWEEP = 1024 };
+		std::unordered_set<SharedString, Hash, Equal> m_strings;
+		size_t m_sweepAt = MIN_SWEEP;
+
+		// Drops the values no node points to anymore. The next sweep waits
+		// until the pool doubles, so each value is looked at a constant
+		// number of times on average.
+		void sweep()
+		{
+			for (auto it = m_strings.begin(); it != m_strings.end();)
+			{
+				if (it->use_count() == 1)
+					it = m_strings.erase(it);
+				else
+					++it;
+			}
+
+			m_sweepAt = 2 * m_strings.size();
+			if (m_sweepAt < MIN_SWEEP)
+				m_sweepAt = MIN_SWEEP;
+		}
+
+		SharedString insert(SharedString&& value)
+		{
+			if (m_strings.size() >= m_sweepAt)
+				sweep();
+			m_strings.insert(value);
+			return value;
+		}
+	public:
+		SharedString intern(const std::string& value)
+		{
+			// non-owning key, so that a hit does not allocate anything
+			SharedString key(SharedString(), &value);
+			auto it = m_strings.find(key);
+			if (it != m_strings.end())
+				return *it;
+
+			return insert(std::make_shared<const std::string>(value));
+		}
+
+		SharedString intern(std::string&& value)
+		{
+			SharedString key(SharedString(), &value);
+			auto it = m_strings.find(key);
+			if (it != m_strings.end())
+				return *it;
+
+			return insert(std::make_shared<const std::string>(std::move(value)));
+		}
+
+		// the values in use and the ones waiting for the sweep
+		size_t size() const { return m_strings.size(); }
+
+		StringPoolStats stats() const
+		{
+			StringPoolStats out = { 0, 0, 0 };
+			for (auto&& s : m_strings)
+			{
+				// the pool keeps one reference; every user beyond
+				// the first would otherwise hold a copy of its own;
+				// the values left without users wait for the sweep
+				size_t users = (size_t)s.use_count() - 1;
+				if (!users)
+					continue;
+				++out.strings;
+				out.references += users;
+				if (users > 1)
+					out.bytesSaved += (users - 1) * s->length();
+			}
+			return out;
+		}
+	};
+}}
+
+#endif // __DOM_INTERNAL_STRING_POOL_HPP__
@@ -32,7 +32,7 @@ namespace dom { namespace impl {
 	class Text : public ChildNodeImpl<Text, dom::Text>
 	{
 	public:
-		Text(const Init& init) : ChildNodeImpl(init) {}
+		Text(Init&& init) : ChildNodeImpl(std::move(init)) {}
 	};
 }}
 
@@ -24,219 +24,364 @@
 
 #include "pch.h"
 #include <dom/parsers/encoding_db.hpp>
+#include "mapped_file.hpp"
+#include "transcoder.hpp"
+#include "builtin_charsets.hpp"
 
-#include <mt.hpp>
-#include <utils.hpp>
+#include <algorithm>
+#include <atomic>
 #include <vector>
+#include <cstring>
 
 namespace dom { namespace parsers {
 
-	struct Encoding
+	namespace
 	{
-		const char* m_name;
-		const int* m_table;
-		size_t m_size;
-		Encoding(const char* name, const int* table, size_t size)
-			: m_name(name)
-			, m_table(table)
-			, m_size(size)
+		struct FileHeader
 		{
-		}
-	};
-
-	class EncodingDB : private mt::AsyncData
-	{
-		using Encodings = std::vector<Encoding>;
+			unsigned int magic, count, strings;
+		};
 
-		Encodings m_encodings;
-		filesystem::path m_dbPath;
-		char* m_data;
-		bool m_opened;
+		struct TableHeader
+		{
+			unsigned int string, table, size;
+		};
 
-		void _close();
-		bool _open();
+		enum { MAX_NAME = 64 };
 
-		static EncodingDB& get()
+		// lowercased copy on the stack; false for names no charset can have
+		static bool normalize(const char* name, char (&out)[MAX_NAME], size_t& length)
 		{
-			static EncodingDB db;
-			return db;
+			length = 0;
+			for (; *name; ++name)
+			{
+				if (length + 1 >= MAX_NAME)
+					return false;
+				char c = *name;
+				if (c >= 'A' && c <= 'Z')
+					c += 'a' - 'A';
+				out[length++] = c;
+			}
+			out[length] = 0;
+			return true;
 		}
 
-		const Encoding* _find(std::string enc)
+		static inline uint32_t hash(const char* name, size_t length, uint32_t seed)
 		{
-			std::tolower(enc);
-			auto it = std::lower_bound(m_encodings.begin(), m_encodings.end(), enc,
-				[](const Encoding& enc, const std::string& key)
+			uint32_t h = 2166136261u ^ seed;
+			for (size_t i = 0; i < length; ++i)
 			{
-				// this supposed to be equivalent of "less(enc.m_name, key)" (notice reversed arguments)
-				return key.compare(enc.m_name) > 0;
-			});
-			if (it == m_encodings.end() || enc.compare(it->m_name) != 0)
-				return nullptr;
-			return &*it;
+				h ^= (unsigned char)name[i];
+				h *= 16777619u;
+			}
+			return h;
 		}
 
-		EncodingDB()
-			: m_data(nullptr)
-			, m_opened(false)
+		// The common charsets are compiled in (see builtin_charsets.hpp)
+		// and found without the database; it only adds the rarer ones
+		static int findBuiltin(const std::string& name)
 		{
+			char key[MAX_NAME];
+			size_t length;
+			if (!normalize(name.c_str(), key, length))
+				return -1;
+
+			auto begin = std::begin(builtin::aliases);
+			auto end = std::end(builtin::aliases);
+			auto it = std::lower_bound(begin, end, key, [](const builtin::Alias& alias, const char* key) {
+				return strcmp(alias.name, key) < 0;
+			});
+			if (it == end || strcmp(it->name, key))
+				return -1;
+			return (int)it->index;
 		}
-	public:
-		static mt::AsyncData& guard() { return get(); }
-		static void init(const filesystem::path& path) { get().m_dbPath = path; close(); }
-		static void close() { get()._close(); }
-		static bool open() { return get()._open(); }
-		static const Encoding* find(const std::string& enc) { return get()._find(enc); }
-	};
 
-	namespace
-	{
-		struct File
+		static void builtinTable(int index, int(&table)[256])
 		{
-			FILE* m_ptr;
-			size_t m_size;
-			File(const filesystem::path& path)
-			{
-				m_ptr = fopen(path.native().c_str(), "rb");
-				m_size = (size_t)filesystem::file_size(path);
-			}
+			auto upper = builtin::tables[index];
+			for (int c = 0; c < 0x80; ++c)
+				table[c] = c;
+			for (int c = 0; c < 0x80; ++c)
+				table[0x80 + c] = upper[c] == 0xFFFF ? -1 : upper[c];
+		}
 
-			~File()
-			{
-				if (*this)
-					fclose(m_ptr);
-			}
+		static TranscoderPtr builtinTranscoder(int index)
+		{
+			static TranscoderPtr cache[sizeof(builtin::tables) / sizeof(builtin::tables[0])];
 
-			operator bool() { return m_ptr != nullptr; }
+			auto& slot = cache[index];
+			auto conv = std::atomic_load(&slot);
+			if (conv)
+				return conv;
 
-			size_t read(void* dst, size_t bytes) { return fread(dst, 1, bytes, m_ptr); }
-			template <typename T> bool read(T& t) { return read(&t, sizeof(T)) == sizeof(T); }
+			int table[256];
+			builtinTable(index, table);
+			TranscoderPtr created = std::make_shared<const Transcoder>(table);
 
-			size_t size() { return m_size; }
-		};
+			TranscoderPtr expected;
+			if (std::atomic_compare_exchange_strong(&slot, &expected, created))
+				return created;
+			return expected;
+		}
+	}
 
-		struct AutoCloser
+	// One opened version of the database. It never changes after open;
+	// reload builds a new one and swaps the pointer, while the parsers
+	// still using the old one keep it alive through their references.
+	class EncodingDB : public std::enable_shared_from_this<EncodingDB>
+	{
+		struct Encoding
 		{
-			char*& data;
-			bool close;
-			AutoCloser(char*& data) : data(data), close(true) {}
-			~AutoCloser()
-			{
-				if (close)
-				{
-					delete[] data;
-					data = nullptr;
-				}
-			}
-			void release() { close = false; }
+			const char* name;
+			size_t length;
+			const int* table;
+			mutable TranscoderPtr transcoder; // created on first use; atomic access only
 		};
 
-		struct FileHeader
+		MappedFile m_file;
+		std::vector<Encoding> m_encodings;
+		std::vector<uint32_t> m_slots; // perfect hash; index + 1 into m_encodings, 0 for empty
+		uint32_t m_seed;
+		uint32_t m_mask;
+
+		static int compare(const Encoding& lhs, const Encoding& rhs)
 		{
-			unsigned int magic, count, strings;
-		};
+			size_t length = lhs.length < rhs.length ? lhs.length : rhs.length;
+			int cmp = memcmp(lhs.name, rhs.name, length);
+			if (cmp)
+				return cmp;
+			return lhs.length < rhs.length ? -1 : lhs.length > rhs.length ? 1 : 0;
+		}
 
-		struct TableHeader
+		bool open(const filesystem::path& path);
+		bool buildHash();
+		const Encoding* find(const std::string& name) const;
+
+		static std::shared_ptr<const EncodingDB>& current()
 		{
-			unsigned int string, table, size;
-		};
-	}
+			static std::shared_ptr<const EncodingDB> db;
+			return db;
+		}
 
-	void EncodingDB::_close()
-	{
-		if (!m_opened)
-			return;
+	public:
+		EncodingDB() : m_seed(0), m_mask(0) {}
 
-		m_encodings.clear();
+		static void load(const filesystem::path& path)
+		{
+			auto db = std::make_shared<EncodingDB>();
+			if (!db->open(path))
+				db = std::make_shared<EncodingDB>(); // empty, but a valid snapshot
 
-		delete[] m_data;
-		m_data = nullptr;
+			std::atomic_store(&current(), std::shared_ptr<const EncodingDB>(db));
+		}
 
-		m_opened = false;
-	}
+		static std::shared_ptr<const EncodingDB> get()
+		{
+			return std::atomic_load(&current());
+		}
 
-	bool EncodingDB::_open()
-	{
-		if (m_opened)
-			return true;
+		bool table(const std::string& name, int(&table)[256]) const;
+		TranscoderPtr transcoder(const std::string& name) const;
+	};
 
-		File file(m_dbPath);
-		if (!file)
+	bool EncodingDB::open(const filesystem::path& path)
+	{
+		if (!m_file.open(path))
 			return false;
 
+		const char* data = m_file.data();
+		size_t size = m_file.size();
+
 		FileHeader header;
-		if (!file.read(header)) return false;
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, data, sizeof(header));
 
 		static const unsigned int MAGIC = 0x54455343;
 		if (header.magic != MAGIC) return false;
-		size_t stringsStart = sizeof(header)+sizeof(TableHeader)*header.count;
-		size_t minimalOffset = stringsStart + header.strings;
-		minimalOffset = ((minimalOffset + 3) >> 2) << 2;
-		if (minimalOffset > file.size())
+		size_t stringsStart = sizeof(header) + sizeof(TableHeader) * header.count;
+		size_t stringsEnd = stringsStart + header.strings;
+		size_t minimalOffset = ((stringsEnd + 3) >> 2) << 2;
+		if (minimalOffset > size)
 			return false;
 
-		size_t buffer = file.size() - stringsStart;
-		m_data = new (std::nothrow) char[buffer];
-		if (!m_data)
-			return false;
-		AutoCloser guard(m_data);
-
 		m_encodings.reserve(header.count);
 		for (unsigned int i = 0; i < header.count; ++i)
 		{
 			TableHeader head;
-			if (!file.read(head)) return false;
+			memcpy(&head, data + sizeof(header) + sizeof(TableHeader) * i, sizeof(head));
 
 			if (head.table < minimalOffset)
 				return false;
-			if (head.table + head.size > file.size())
+			if ((size_t)head.table + head.size > size)
 				return false;
-			if (head.string < stringsStart || head.string >= (stringsStart + header.strings))
+			// the tables are read in place, as ints
+			if (head.table % sizeof(int))
+				return false;
+			if (head.string < stringsStart || head.string >= stringsEnd)
 				return false;
 
-			const char* name = m_data + head.string - stringsStart;
-			const int* table = (int*)(m_data + head.table - stringsStart);
+			const char* name = data + head.string;
+			auto end = (const char*)memchr(name, 0, stringsEnd - head.string);
+			if (!end)
+				return false;
 
-			m_encodings.emplace_back(name, table, head.size);
+			// tables too short for a full single-byte map are never found
+			if (head.size < sizeof(int[256]))
+				continue;
+
+			Encoding enc = { name, (size_t)(end - name), (const int*)(data + head.table), nullptr };
+			m_encodings.push_back(enc);
 		}
 
-		if (file.read(m_data, buffer) != buffer)
-			return false;
+		// a repeated name would collide under every seed; the first
+		// table with a given name wins
+		std::stable_sort(m_encodings.begin(), m_encodings.end(), [](const Encoding& lhs, const Encoding& rhs) {
+			return compare(lhs, rhs) < 0;
+		});
+		m_encodings.erase(std::unique(m_encodings.begin(), m_encodings.end(), [](const Encoding& lhs, const Encoding& rhs) {
+			return !compare(lhs, rhs);
+		}), m_encodings.end());
 
-		guard.release();
-		return m_opened = true;
+		return buildHash();
 	}
 
-	void init(const filesystem::path& path)
+	bool EncodingDB::buildHash()
 	{
-		Synchronize on(EncodingDB::guard());
+		// n names in m slots fall into separate slots with the chance of
+		// about exp(-n*n/2m); starting at m >= n*n/8 gives each seed at
+		// least 1 in 60 and a handful of sizes is then more than enough
+		size_t count = m_encodings.size();
+		size_t size = 8;
+		while (size < count * 2 || size < count * count / 8)
+			size <<= 1;
+
+		for (int sizes = 0; sizes < 4 && size <= (1u << 20); ++sizes, size <<= 1)
+		{
+			m_mask = (uint32_t)size - 1;
+			m_slots.assign(size, 0);
+			for (uint32_t seed = 1; seed < 1000; ++seed)
+			{
+				size_t i = 0;
+				for (; i < count; ++i)
+				{
+					auto& enc = m_encodings[i];
+					auto& slot = m_slots[hash(enc.name, enc.length, seed) & m_mask];
+					if (slot)
+						break;
+					slot = (uint32_t)i + 1;
+				}
 
-		EncodingDB::init(path);
-	}
+				if (i == count)
+				{
+					m_seed = seed;
+					return true;
+				}
 
-	void reload(const filesystem::path& path)
-	{
-		Synchronize on(EncodingDB::guard());
+				// only the slots this seed has filled need clearing
+				while (i--)
+				{
+					auto& enc = m_encodings[i];
+					m_slots[hash(enc.name, enc.length, seed) & m_mask] = 0;
+				}
+			}
+		}
 
-		EncodingDB::init(path); // re-init.
+		m_slots.clear();
+		return false;
 	}
 
-	bool loadCharset(const std::string& encoding, int(&table)[256])
+	const EncodingDB::Encoding* EncodingDB::find(const std::string& name) const
 	{
-		Synchronize on(EncodingDB::guard());
+		if (m_slots.empty())
+			return nullptr;
 
-		if (!EncodingDB::open())
-			return false;
+		char key[MAX_NAME];
+		size_t length;
+		if (!normalize(name.c_str(), key, length))
+			return nullptr;
 
-		auto obj = EncodingDB::find(encoding);
+		auto slot = m_slots[hash(key, length, m_seed) & m_mask];
+		if (!slot)
+			return nullptr;
 
-		if (!obj)
-			return false;
+		auto& enc = m_encodings[slot - 1];
+		if (enc.length != length || memcmp(enc.name, key, length))
+			return nullptr;
+
+		return &enc;
+	}
 
-		if (obj->m_size < sizeof(table))
+	bool EncodingDB::table(const std::string& name, int(&table)[256]) const
+	{
+		auto enc = find(name);
+		if (!enc)
 			return false;
 
-		memcpy(table, obj->m_table, sizeof(table));
+		memcpy(table, enc->table, sizeof(table));
 		return true;
 	}
+
+	TranscoderPtr EncodingDB::transcoder(const std::string& name) const
+	{
+		auto enc = find(name);
+		if (!enc)
+			return nullptr;
+
+		auto conv = std::atomic_load(&enc->transcoder);
+		if (conv)
+			return conv;
+
+		int table[256];
+		memcpy(table, enc->table, sizeof(table));
+		TranscoderPtr created = std::make_shared<const Transcoder>(table);
+
+		// two threads may race here; both end up with the first one stored
+		TranscoderPtr expected;
+		if (std::atomic_compare_exchange_strong(&enc->transcoder, &expected, created))
+			return created;
+		return expected;
+	}
+
+	void init(const filesystem::path& path)
+	{
+		EncodingDB::load(path);
+	}
+
+	void reload(const filesystem::path& path)
+	{
+		EncodingDB::load(path);
+	}
+
+	bool loadCharset(const std::string& encoding, int(&table)[256])
+	{
+		int builtin = findBuiltin(encoding);
+		if (builtin >= 0)
+		{
+			builtinTable(builtin, table);
+			return true;
+		}
+
+		auto db = EncodingDB::get();
+		return db && db->table(encoding, table);
+	}
+
+	TranscoderPtr Transcoder::get(const std::string& charset)
+	{
+		try
+		{
+			int builtin = findBuiltin(charset);
+			if (builtin >= 0)
+				return builtinTranscoder(builtin);
+
+			auto db = EncodingDB::get();
+			if (!db)
+				return nullptr;
+			return db->transcoder(charset);
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
 }}
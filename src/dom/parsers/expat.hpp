@@ -43,6 +43,32 @@ namespace xml
 
 		bool isCreated() const { return m_parser != nullptr; }
 
+		// Brings the parser back to the state right after create; all
+		// the handlers need to be enabled again
+		bool reset(const XML_Char* encoding = nullptr)
+		{
+			if (!m_parser)
+				return false;
+
+			if (encoding != nullptr && encoding [0] == 0)
+				encoding = nullptr;
+
+			if (!XML_ParserReset(m_parser, encoding))
+				return false;
+
+			Final* pThis = static_cast<Final*>(this);
+			pThis->onPostCreate();
+
+			XML_SetUserData(m_parser, (void*) pThis);
+			return true;
+		}
+
+		// with a namespace separator, names are reported as "uri<sep>local<sep>prefix"
+		void setReturnNSTriplet(bool enable = true)
+		{
+			XML_SetReturnNSTriplet(m_parser, enable ? 1 : 0);
+		}
+
 		void destroy()
 		{
 			if (m_parser)
@@ -162,6 +188,17 @@ namespace xml
 			enableEndDoctypeDeclHandler(enable);
 		}
 
+		// callable from the handlers; the current parse call returns an
+		// XML_ERROR_ABORTED error
+		void stop()
+		{
+			XML_StopParser(m_parser, XML_FALSE);
+		}
+		int getSpecifiedAttributeCount()
+		{
+			return XML_GetSpecifiedAttributeCount(m_parser);
+		}
+
 		enum XML_Error getErrorCode()
 		{
 			return XML_GetErrorCode(m_parser);
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_EXPAT_PARSER_HPP__
+#define __DOM_INTERNAL_EXPAT_PARSER_HPP__
+
+#include <dom/parsers/encoding_db.hpp>
+#include "expat.hpp"
+#include <string>
+
+namespace dom { namespace parsers { namespace xml {
+
+	// Common base of the expat-driven parsers: the charsets from the
+	// encoding DB and the text collected between the tags
+	template <typename Final>
+	class ExpatParser : public ::xml::ExpatBase<Final>
+	{
+	protected:
+		std::string text;
+	public:
+
+		bool create(const std::string& cp, const XML_Char* sep = nullptr)
+		{
+			return ::xml::ExpatBase<Final>::create(cp.empty() ? nullptr : cp.c_str(), sep);
+		}
+
+		bool onUnknownEncoding(const XML_Char* name, XML_Encoding* info)
+		{
+			info->data = nullptr;
+			info->convert = nullptr;
+			info->release = nullptr;
+
+			if (!loadCharset(name, info->map))
+			{
+				//printf("Unknown encoding: %s\n", name);
+				return false;
+			}
+
+			return true;
+		}
+
+		void onCharacterData(const XML_Char *pszData, int nLength)
+		{
+			text.append(pszData, nLength);
+		}
+	};
+}}}
+
+#endif // __DOM_INTERNAL_EXPAT_PARSER_HPP__
@@ -0,0 +1,1034 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <dom/parsers/feed.hpp>
+#include <dom/string_view.hpp>
+#include <libweb/alloc_scope.hpp>
+#include "expat_parser.hpp"
+#include "mapped_file.hpp"
+#include "void_elements.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace dom { namespace parsers { namespace feed {
+
+	namespace
+	{
+		const char* skipSpace(const char* ptr)
+		{
+			while (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n')
+				++ptr;
+			return ptr;
+		}
+
+		// reads exactly count digits
+		bool number(const char*& ptr, int count, int& value)
+		{
+			value = 0;
+			for (int i = 0; i < count; ++i, ++ptr)
+			{
+				if (*ptr < '0' || *ptr > '9')
+					return false;
+				value = value * 10 + *ptr - '0';
+			}
+			return true;
+		}
+
+		// reads one or more digits
+		bool number(const char*& ptr, int& value)
+		{
+			if (*ptr < '0' || *ptr > '9')
+				return false;
+			value = 0;
+			while (*ptr >= '0' && *ptr <= '9')
+				value = value * 10 + *ptr++ - '0';
+			return true;
+		}
+
+		bool startsWith(const char* ptr, const char* prefix)
+		{
+			for (; *prefix; ++ptr, ++prefix)
+			{
+				if (tolower((unsigned char)*ptr) != *prefix)
+					return false;
+			}
+			return true;
+		}
+
+		// days since 1970-01-01 in the proleptic Gregorian calendar
+		long long daysFromCivil(int y, int m, int d)
+		{
+			y -= m <= 2;
+			long long era = (y >= 0 ? y : y - 399) / 400;
+			long long yoe = y - era * 400;
+			long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+			long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+			return era * 146097 + doe - 719468;
+		}
+
+		time_t makeTime(int year, int month, int day, int hour, int minute, int second, int offset)
+		{
+			if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 24 || minute > 59 || second > 60)
+				return 0;
+			long long days = daysFromCivil(year, month, day);
+			return (time_t)(days * 86400 + hour * 3600 + minute * 60 + second - offset);
+		}
+
+		// "+hh:mm", "+hhmm", "Z" or one of the RFC 822 names; in seconds
+		bool zone(const char* ptr, int& offset)
+		{
+			ptr = skipSpace(ptr);
+			offset = 0;
+			if (*ptr == '+' || *ptr == '-')
+			{
+				int sign = *ptr++ == '-' ? -1 : 1;
+				int hours, minutes = 0;
+				if (!number(ptr, 2, hours))
+					return false;
+				if (*ptr == ':')
+					++ptr;
+				number(ptr, 2, minutes);
+				offset = sign * (hours * 3600 + minutes * 60);
+				return true;
+			}
+
+			struct Zone
+			{
+				const char* name;
+				int hours;
+			};
+			static const Zone zones[] = {
+				{ "gmt", 0 }, { "utc", 0 }, { "ut", 0 }, { "z", 0 },
+				{ "est", -5 }, { "edt", -4 }, { "cst", -6 }, { "cdt", -5 },
+				{ "mst", -7 }, { "mdt", -6 }, { "pst", -8 }, { "pdt", -7 },
+			};
+			for (auto&& item : zones)
+			{
+				if (startsWith(ptr, item.name))
+				{
+					offset = item.hours * 3600;
+					return true;
+				}
+			}
+			return !*ptr; // no zone at all is taken as UTC
+		}
+
+		// "Mon, 01 Jul 2013 10:00:00 +0200"; the weekday and the seconds are optional
+		time_t rfc822(const char* ptr)
+		{
+			ptr = skipSpace(ptr);
+			const char* comma = strchr(ptr, ',');
+			if (comma)
+				ptr = skipSpace(comma + 1);
+
+			int day, year, hour, minute, second = 0;
+			if (!number(ptr, day))
+				return 0;
+			ptr = skipSpace(ptr);
+
+			static const char* months[] = { "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec" };
+			int month = 0;
+			for (int i = 0; i < 12; ++i)
+			{
+				if (startsWith(ptr, months[i]))
+				{
+					month = i + 1;
+					break;
+				}
+			}
+			if (!month)
+				return 0;
+			while (isalpha((unsigned char)*ptr))
+				++ptr;
+			ptr = skipSpace(ptr);
+
+			const char* yearStart = ptr;
+			if (!number(ptr, year))
+				return 0;
+			if (ptr - yearStart <= 2)
+				year += year < 50 ? 2000 : 1900;
+			ptr = skipSpace(ptr);
+
+			if (!number(ptr, 2, hour) || *ptr++ != ':' || !number(ptr, 2, minute))
+				return 0;
+			if (*ptr == ':')
+			{
+				++ptr;
+				if (!number(ptr, 2, second))
+					return 0;
+			}
+
+			int offset;
+			if (!zone(ptr, offset))
+				return 0;
+			return makeTime(year, month, day, hour, minute, second, offset);
+		}
+
+		// "2013-07-01T10:00:00.123+02:00"; the time may be missing
+		time_t rfc3339(const char* ptr)
+		{
+			ptr = skipSpace(ptr);
+			int year, month, day, hour = 0, minute = 0, second = 0;
+			if (!number(ptr, 4, year) || *ptr++ != '-' || !number(ptr, 2, month) || *ptr++ != '-' || !number(ptr, 2, day))
+				return 0;
+
+			if (*ptr == 'T' || *ptr == 't' || *ptr == ' ')
+			{
+				++ptr;
+				if (!number(ptr, 2, hour) || *ptr++ != ':' || !number(ptr, 2, minute))
+					return 0;
+				if (*ptr == ':')
+				{
+					++ptr;
+					if (!number(ptr, 2, second))
+						return 0;
+					if (*ptr == '.' || *ptr == ',')
+					{
+						++ptr;
+						while (*ptr >= '0' && *ptr <= '9')
+							++ptr;
+					}
+				}
+			}
+
+			int offset;
+			if (!zone(ptr, offset))
+				return 0;
+			return makeTime(year, month, day, hour, minute, second, offset);
+		}
+
+		enum NS
+		{
+			NS_NONE,
+			NS_ATOM,
+			NS_RSS1,
+			NS_RDF,
+			NS_CONTENT,
+			NS_DC,
+			NS_OTHER
+		};
+
+		// U+0001 cannot appear in an XML 1.0 name or URI
+		const XML_Char NS_SEP = 1;
+
+		struct Name
+		{
+			NS ns;
+			string_view local;
+
+			bool is(NS ns, const char* name) const
+			{
+				size_t length = strlen(name);
+				return this->ns == ns && local.size() == length && !memcmp(local.data(), name, length);
+			}
+		};
+
+		NS knownNamespace(const string_view& uri)
+		{
+			struct Namespace
+			{
+				const char* uri;
+				NS ns;
+			};
+			static const Namespace known[] = {
+				{ "http://www.w3.org/2005/Atom", NS_ATOM },
+				{ "http://purl.org/rss/1.0/", NS_RSS1 },
+				{ "http://www.w3.org/1999/02/22-rdf-syntax-ns#", NS_RDF },
+				{ "http://purl.org/rss/1.0/modules/content/", NS_CONTENT },
+				{ "http://purl.org/dc/elements/1.1/", NS_DC },
+			};
+
+			for (auto&& item : known)
+			{
+				if (uri == item.uri)
+					return item.ns;
+			}
+			return NS_OTHER;
+		}
+
+		// the prefixes the feeds use for the known namespaces, for the
+		// feeds, which use them without declaring them
+		NS knownPrefix(const string_view& prefix)
+		{
+			struct Prefix
+			{
+				const char* prefix;
+				NS ns;
+			};
+			static const Prefix known[] = {
+				{ "atom", NS_ATOM },
+				{ "rdf", NS_RDF },
+				{ "content", NS_CONTENT },
+				{ "dc", NS_DC },
+			};
+
+			for (auto&& item : known)
+			{
+				if (prefix == item.prefix)
+					return item.ns;
+			}
+			return NS_OTHER;
+		}
+
+		Name splitName(const XML_Char* name)
+		{
+			const XML_Char* sep = strchr(name, NS_SEP);
+			if (!sep)
+			{
+				Name out = { NS_NONE, name };
+				return out;
+			}
+
+			Name out = { knownNamespace(string_view(name, sep - name)), sep + 1 };
+			return out;
+		}
+
+		std::string trimmed(const std::string& text)
+		{
+			auto start = text.find_first_not_of(" \t\r\n");
+			if (start == std::string::npos)
+				return std::string();
+			auto end = text.find_last_not_of(" \t\r\n");
+			return text.substr(start, end - start + 1);
+		}
+
+		CONTENT_TYPE atomType(const XML_Char* type)
+		{
+			if (!type || !strcmp(type, "text"))
+				return CONTENT_TEXT;
+			if (!strcmp(type, "html"))
+				return CONTENT_HTML;
+			if (!strcmp(type, "xhtml"))
+				return CONTENT_XHTML;
+			return CONTENT_TEXT;
+		}
+
+		void appendEscaped(std::string& out, const char* data, size_t length, bool attribute)
+		{
+			const char* end = data + length;
+			for (; data != end; ++data)
+			{
+				switch (*data)
+				{
+				case '&': out.append("&amp;"); break;
+				case '<': out.append("&lt;"); break;
+				case '>': out.append("&gt;"); break;
+				case '"':
+					if (attribute)
+						out.append("&quot;");
+					else
+						out.push_back('"');
+					break;
+				default:
+					out.push_back(*data);
+				}
+			}
+		}
+	}
+
+	time_t parseDate(const std::string& text)
+	{
+		auto ptr = skipSpace(text.c_str());
+		if (*ptr >= '0' && *ptr <= '9' && ptr[1] >= '0' && ptr[1] <= '9' && ptr[2] >= '0' && ptr[2] <= '9' && ptr[3] >= '0' && ptr[3] <= '9' && ptr[4] == '-')
+			return rfc3339(ptr);
+		return rfc822(ptr);
+	}
+
+	class FeedParser : public xml::ExpatParser<FeedParser>
+	{
+		enum FIELD
+		{
+			NONE,
+			TITLE,
+			LINK,
+			GUID,
+			AUTHOR,
+			PUBLISHED,
+			UPDATED,
+			SUMMARY,
+			CONTENT,
+			CATEGORY,
+			DESCRIPTION,
+			LANGUAGE,
+			IGNORED // a known element with everything in the attributes
+		};
+
+		Feed* feed;
+		Item* item;
+		size_t depth;
+		size_t scopeDepth;  // the channel (or feed) or the item, whose children are the fields
+		size_t authorDepth; // Atom author, whose name is the field
+		FIELD field;
+		size_t fieldDepth;
+		Content* content;   // the target of SUMMARY and CONTENT
+		bool markupOpen;    // the last XHTML start tag still waits for its '>'
+		bool namespaces;    // expat resolves the prefixes; see resolve below
+
+		// the xmlns declarations, when the parser does not resolve them
+		struct Declaration
+		{
+			std::string prefix;
+			NS ns;
+			size_t depth;
+		};
+		std::vector<Declaration> declarations;
+
+		static const size_t NOWHERE = (size_t)-1;
+
+		void declare(const XML_Char** attrs)
+		{
+			for (; *attrs; attrs += 2)
+			{
+				auto name = attrs[0];
+				if (strncmp(name, "xmlns", 5) || (name[5] && name[5] != ':'))
+					continue;
+
+				Declaration decl;
+				decl.prefix = name[5] ? name + 6 : "";
+				decl.ns = *attrs[1] ? knownNamespace(attrs[1]) : NS_NONE;
+				decl.depth = depth;
+				declarations.push_back(std::move(decl));
+			}
+		}
+
+		NS declared(const string_view& prefix)
+		{
+			for (auto it = declarations.rbegin(); it != declarations.rend(); ++it)
+			{
+				if (prefix == it->prefix)
+					return it->ns;
+			}
+			return prefix.empty() ? NS_NONE : knownPrefix(prefix);
+		}
+
+		// The names as "prefix:local", matched against the declarations
+		// seen so far; an undeclared prefix is taken for the namespace
+		// the feeds usually bind it to
+		Name resolve(const XML_Char* name, bool isAttribute)
+		{
+			if (namespaces)
+				return splitName(name);
+
+			const XML_Char* colon = strchr(name, ':');
+			if (!colon)
+			{
+				Name out = { NS_NONE, name };
+				if (!isAttribute)
+					out.ns = declared(string_view());
+				else if (!strcmp(name, "xmlns"))
+					out.ns = NS_OTHER;
+				return out;
+			}
+
+			string_view prefix(name, colon - name);
+			Name out = { NS_OTHER, colon + 1 };
+			if (prefix != "xmlns" && prefix != "xml")
+				out.ns = declared(prefix);
+			return out;
+		}
+
+		const XML_Char* attribute(const XML_Char** attrs, NS ns, const char* name)
+		{
+			for (; *attrs; attrs += 2)
+			{
+				if (resolve(attrs[0], true).is(ns, name))
+					return attrs[1];
+			}
+			return nullptr;
+		}
+
+		void link(const XML_Char** attrs, std::vector<Link>& links, std::string& alternate, std::vector<Enclosure>* enclosures)
+		{
+			auto href = attribute(attrs, NS_NONE, "href");
+			if (!href)
+				return;
+
+			auto rel = attribute(attrs, NS_NONE, "rel");
+			auto type = attribute(attrs, NS_NONE, "type");
+			if (enclosures && rel && !strcmp(rel, "enclosure"))
+			{
+				Enclosure enclosure;
+				enclosure.url = href;
+				if (type)
+					enclosure.type = type;
+				auto length = attribute(attrs, NS_NONE, "length");
+				if (length)
+					enclosure.length = strtoul(length, nullptr, 10);
+				enclosures->push_back(std::move(enclosure));
+				return;
+			}
+
+			Link out;
+			out.href = href;
+			out.rel = rel ? rel : "alternate";
+			if (type)
+				out.type = type;
+			if (alternate.empty() && out.rel == "alternate")
+				alternate = out.href;
+			links.push_back(std::move(out));
+		}
+
+		FIELD itemField(const Name& name, const XML_Char** attrs)
+		{
+			switch (name.ns)
+			{
+			case NS_NONE:
+			case NS_RSS1:
+				if (name.local == "title") return TITLE;
+				if (name.local == "link") return LINK;
+				if (name.local == "description")
+				{
+					content = &item->summary;
+					content->type = CONTENT_HTML;
+					return SUMMARY;
+				}
+				if (name.ns == NS_RSS1)
+					return NONE;
+				if (name.local == "guid") return GUID;
+				if (name.local == "author") return AUTHOR;
+				if (name.local == "pubDate") return PUBLISHED;
+				if (name.local == "category") return CATEGORY;
+				if (name.local == "enclosure")
+				{
+					Enclosure enclosure;
+					auto url = attribute(attrs, NS_NONE, "url");
+					auto type = attribute(attrs, NS_NONE, "type");
+					auto length = attribute(attrs, NS_NONE, "length");
+					if (!url)
+						return IGNORED;
+					enclosure.url = url;
+					if (type)
+						enclosure.type = type;
+					if (length)
+						enclosure.length = strtoul(length, nullptr, 10);
+					item->enclosures.push_back(std::move(enclosure));
+					return IGNORED;
+				}
+				break;
+			case NS_CONTENT:
+				if (name.local == "encoded")
+				{
+					content = &item->content;
+					content->type = CONTENT_HTML;
+					return CONTENT;
+				}
+				break;
+			case NS_DC:
+				if (name.local == "creator") return AUTHOR;
+				if (name.local == "date") return PUBLISHED;
+				if (name.local == "subject") return CATEGORY;
+				break;
+			case NS_ATOM:
+				if (name.local == "title") return TITLE;
+				if (name.local == "id") return GUID;
+				if (name.local == "published") return PUBLISHED;
+				if (name.local == "updated") return UPDATED;
+				if (name.local == "link")
+				{
+					link(attrs, item->links, item->link, &item->enclosures);
+					return IGNORED;
+				}
+				if (name.local == "category")
+				{
+					auto term = attribute(attrs, NS_NONE, "term");
+					if (term)
+						item->categories.push_back(term);
+					return IGNORED;
+				}
+				if (name.local == "author")
+				{
+					authorDepth = depth; // the name is picked up below
+					return NONE;
+				}
+				if (name.local == "summary" || name.local == "content")
+				{
+					if (name.local == "content" && attribute(attrs, NS_NONE, "src"))
+						return IGNORED; // out of line
+					content = name.local == "summary" ? &item->summary : &item->content;
+					content->type = atomType(attribute(attrs, NS_NONE, "type"));
+					return name.local == "summary" ? SUMMARY : CONTENT;
+				}
+				break;
+			default:
+				break;
+			}
+			return NONE;
+		}
+
+		FIELD feedField(const Name& name, const XML_Char** attrs)
+		{
+			switch (name.ns)
+			{
+			case NS_NONE:
+			case NS_RSS1:
+				if (name.local == "title") return TITLE;
+				if (name.local == "link") return LINK;
+				if (name.local == "description") return DESCRIPTION;
+				if (name.ns == NS_NONE)
+				{
+					if (name.local == "language") return LANGUAGE;
+					if (name.local == "lastBuildDate") return UPDATED;
+					if (name.local == "pubDate" && feed->updatedText.empty()) return UPDATED;
+				}
+				break;
+			case NS_DC:
+				if (name.local == "language") return LANGUAGE;
+				if (name.local == "date") return UPDATED;
+				break;
+			case NS_ATOM:
+				if (name.local == "title") return TITLE;
+				if (name.local == "subtitle") return DESCRIPTION;
+				if (name.local == "updated") return UPDATED;
+				if (name.local == "link")
+				{
+					link(attrs, feed->links, feed->link, nullptr);
+					return IGNORED;
+				}
+				break;
+			default:
+				break;
+			}
+			return NONE;
+		}
+
+		void store()
+		{
+			if (item)
+			{
+				switch (field)
+				{
+				case TITLE: item->title = trimmed(text); break;
+				case LINK: item->link = trimmed(text); break;
+				case GUID: item->guid = trimmed(text); break;
+				case AUTHOR: item->author = trimmed(text); break;
+				case PUBLISHED:
+					item->publishedText = trimmed(text);
+					item->published = parseDate(item->publishedText);
+					break;
+				case UPDATED:
+					item->updatedText = trimmed(text);
+					item->updated = parseDate(item->updatedText);
+					break;
+				case SUMMARY:
+				case CONTENT:
+					content->text = std::move(text);
+					break;
+				case CATEGORY: item->categories.push_back(trimmed(text)); break;
+				default: break;
+				}
+			}
+			else
+			{
+				switch (field)
+				{
+				case TITLE: feed->title = trimmed(text); break;
+				case LINK: feed->link = trimmed(text); break;
+				case DESCRIPTION: feed->description = trimmed(text); break;
+				case LANGUAGE: feed->language = trimmed(text); break;
+				case UPDATED:
+					feed->updatedText = trimmed(text);
+					feed->updated = parseDate(feed->updatedText);
+					break;
+				default: break;
+				}
+			}
+			text.clear();
+		}
+
+		bool root(const Name& name)
+		{
+			if (name.is(NS_NONE, "rss"))
+				feed->format = RSS2;
+			else if (name.is(NS_RDF, "RDF"))
+				feed->format = RSS1;
+			else if (name.is(NS_ATOM, "feed"))
+			{
+				feed->format = ATOM;
+				scopeDepth = depth;
+			}
+			else
+				return false;
+			return true;
+		}
+
+		void closeMarkup()
+		{
+			if (markupOpen)
+				text.push_back('>');
+			markupOpen = false;
+		}
+
+		void enableHandlers()
+		{
+			enableElementHandler();
+			enableCharacterDataHandler();
+			enableUnknownEncodingHandler();
+		}
+
+	public:
+		explicit FeedParser(bool namespaces)
+			: feed(nullptr)
+			, item(nullptr)
+			, depth(0)
+			, scopeDepth(NOWHERE)
+			, authorDepth(NOWHERE)
+			, field(NONE)
+			, fieldDepth(0)
+			, content(nullptr)
+			, markupOpen(false)
+			, namespaces(namespaces)
+		{
+		}
+
+		bool usesNamespaces() const { return namespaces; }
+
+		bool create(const std::string& cp)
+		{
+			static const XML_Char sep[] = { NS_SEP, 0 };
+			if (!ExpatParser<FeedParser>::create(cp, namespaces ? sep : nullptr))
+				return false;
+
+			enableHandlers();
+			return true;
+		}
+
+		// expat keeps the namespace mode over a reset
+		bool reset(const std::string& cp)
+		{
+			if (!ExpatParser<FeedParser>::reset(cp.empty() ? nullptr : cp.c_str()))
+				return false;
+
+			enableHandlers();
+			return true;
+		}
+
+		// the state of the previous feed goes, the buffers stay
+		void start(Feed& target)
+		{
+			feed = &target;
+			item = nullptr;
+			depth = 0;
+			scopeDepth = NOWHERE;
+			authorDepth = NOWHERE;
+			field = NONE;
+			fieldDepth = 0;
+			content = nullptr;
+			markupOpen = false;
+			text.clear();
+			declarations.clear();
+		}
+
+		void onStartElement(const XML_Char *name, const XML_Char **attrs)
+		{
+			++depth;
+			if (!namespaces)
+				declare(attrs);
+			auto parts = resolve(name, false);
+
+			if (field != NONE)
+			{
+				// Atom XHTML: the wrapping div is left out, the rest is kept
+				if (field == SUMMARY || field == CONTENT)
+				{
+					if (content->type == CONTENT_XHTML && depth > fieldDepth + 1)
+					{
+						closeMarkup();
+						text.push_back('<');
+						text.append(parts.local.data(), parts.local.size());
+						for (; *attrs; attrs += 2)
+						{
+							auto attr = resolve(attrs[0], true);
+							if (attr.ns != NS_NONE)
+								continue;
+							text.push_back(' ');
+							text.append(attr.local.data(), attr.local.size());
+							text.append("=\"");
+							appendEscaped(text, attrs[1], strlen(attrs[1]), true);
+							text.push_back('"');
+						}
+						markupOpen = true;
+					}
+				}
+				return;
+			}
+
+			if (depth == 1)
+			{
+				if (!root(parts))
+					stop();
+				return;
+			}
+
+			if (!item && scopeDepth == NOWHERE)
+			{
+				if ((feed->format == RSS2 && depth == 2 && parts.is(NS_NONE, "channel")) ||
+					(feed->format == RSS1 && depth == 2 && parts.is(NS_RSS1, "channel")))
+				{
+					scopeDepth = depth;
+				}
+				else if (feed->format == RSS1 && depth == 2 && parts.is(NS_RSS1, "item"))
+				{
+					feed->items.emplace_back();
+					item = &feed->items.back();
+					scopeDepth = depth;
+					auto about = attribute(attrs, NS_RDF, "about");
+					if (about)
+						item->guid = about;
+				}
+				return;
+			}
+
+			if (!item && depth == scopeDepth + 1 &&
+				((feed->format == RSS2 && parts.is(NS_NONE, "item")) ||
+				(feed->format == ATOM && parts.is(NS_ATOM, "entry"))))
+			{
+				feed->items.emplace_back();
+				item = &feed->items.back();
+				scopeDepth = depth;
+				return;
+			}
+
+			if (depth == scopeDepth + 1)
+			{
+				field = item ? itemField(parts, attrs) : feedField(parts, attrs);
+				fieldDepth = depth;
+				text.clear();
+				return;
+			}
+
+			if (item && authorDepth != NOWHERE && depth == authorDepth + 1 && parts.is(NS_ATOM, "name"))
+			{
+				field = AUTHOR;
+				fieldDepth = depth;
+				text.clear();
+			}
+		}
+
+		void onEndElement(const XML_Char *name)
+		{
+			if (field != NONE)
+			{
+				if (depth == fieldDepth)
+				{
+					if (field != IGNORED)
+						store();
+					field = NONE;
+					content = nullptr;
+				}
+				else if ((field == SUMMARY || field == CONTENT) && content->type == CONTENT_XHTML && depth > fieldDepth + 1)
+				{
+					auto parts = resolve(name, false);
+					if (markupOpen && isVoidElement(parts.local))
+					{
+						text.append("/>");
+						markupOpen = false;
+					}
+					else
+					{
+						closeMarkup();
+						text.append("</");
+						text.append(parts.local.data(), parts.local.size());
+						text.push_back('>');
+					}
+				}
+			}
+
+			if (depth == authorDepth)
+				authorDepth = NOWHERE;
+
+			while (!declarations.empty() && declarations.back().depth == depth)
+				declarations.pop_back();
+
+			if (depth == scopeDepth)
+			{
+				if (item)
+				{
+					item = nullptr;
+					// back to the channel; the RSS 1.0 items are its siblings
+					scopeDepth = feed->format == RSS1 ? NOWHERE : (feed->format == ATOM ? 1 : 2);
+				}
+				else
+					scopeDepth = NOWHERE;
+			}
+
+			--depth;
+		}
+
+		void onCharacterData(const XML_Char *pszData, int nLength)
+		{
+			if (field == NONE || field == IGNORED)
+				return;
+
+			if ((field == SUMMARY || field == CONTENT) && content->type == CONTENT_XHTML)
+			{
+				if (depth == fieldDepth)
+					return; // the whitespace around the div
+				closeMarkup();
+				appendEscaped(text, pszData, nLength, false);
+				return;
+			}
+
+			text.append(pszData, nLength);
+		}
+	};
+
+	namespace
+	{
+		// One parser of each kind per thread, reset for every feed, the
+		// same way the ParserPool keeps the document parsers
+		class FeedParserPool
+		{
+			std::unique_ptr<FeedParser> m_free[2];
+
+			static FeedParserPool& local()
+			{
+				static thread_local FeedParserPool pool;
+				return pool;
+			}
+		public:
+			static std::unique_ptr<FeedParser> acquire(const std::string& encoding, bool namespaces)
+			{
+				auto parser = std::move(local().m_free[namespaces]);
+				if (parser && (encoding.empty() || parser->reset(encoding)))
+					return parser;
+
+				parser.reset(new FeedParser(namespaces));
+				if (!parser->create(encoding))
+					return nullptr;
+				return parser;
+			}
+
+			static void release(std::unique_ptr<FeedParser>&& parser)
+			{
+				// released parsers are reset for the default encoding
+				if (!parser || !parser->reset(std::string()))
+					return;
+
+				bool namespaces = parser->usesNamespaces();
+				local().m_free[namespaces] = std::move(parser);
+			}
+		};
+
+		static const size_t MAX_PARSE = 1 << 30; // XML_Parse takes an int
+
+		enum RESULT
+		{
+			PARSED,
+			FAILED,
+			UNBOUND_PREFIX
+		};
+
+		RESULT parseWith(bool namespaces, const std::string& encoding, const char* data, size_t size, Feed& feed)
+		{
+			auto parser = FeedParserPool::acquire(encoding, namespaces);
+			if (!parser)
+				return FAILED;
+
+			parser->start(feed);
+			bool success = true;
+			do
+			{
+				size_t chunk = size < MAX_PARSE ? size : MAX_PARSE;
+				success = parser->parse(data, (int)chunk, chunk == size);
+				data += chunk;
+				size -= chunk;
+			} while (success && size);
+
+			RESULT result = success ? PARSED : FAILED;
+			if (!success && parser->getErrorCode() == XML_ERROR_UNBOUND_PREFIX)
+				result = UNBOUND_PREFIX;
+
+			FeedParserPool::release(std::move(parser));
+			return result;
+		}
+
+		// With the namespaces resolved by expat first; a feed with an
+		// undeclared prefix, which expat refuses, is read again with the
+		// prefixes matched by the FeedParser
+		bool parseFeed(const std::string& encoding, const char* data, size_t size, Feed& feed)
+		{
+			auto result = parseWith(true, encoding, data, size, feed);
+			if (result == UNBOUND_PREFIX)
+			{
+				feed = Feed();
+				result = parseWith(false, encoding, data, size, feed);
+			}
+
+			return result == PARSED && feed.format != UNKNOWN;
+		}
+	}
+
+	bool parse(const std::string& encoding, const void* data, size_t size, Feed& feed)
+	{
+		LIBWEB_ALLOC_SCOPE("feed::parse");
+		try
+		{
+			return parseFeed(encoding, (const char*)data, size, feed);
+		}
+		catch (std::bad_alloc&)
+		{
+			return false;
+		}
+	}
+
+	bool parseFile(const filesystem::path& path, Feed& feed)
+	{
+		LIBWEB_ALLOC_SCOPE("feed::parseFile");
+		try
+		{
+			MappedFile file;
+			if (file.open(path))
+				return parseFeed(std::string(), file.data(), file.size(), feed);
+
+			// not a regular file, or an empty one: read in one block, so
+			// that the fallback above may go over it again
+			FILE* f = fopen(path.native().c_str(), "rb");
+			if (!f)
+				return false;
+
+			static const size_t CHUNK = 65536;
+			std::vector<char> contents;
+			size_t used = 0;
+			while (true)
+			{
+				contents.resize(used + CHUNK);
+				size_t read = fread(contents.data() + used, 1, CHUNK, f);
+				if (!read)
+					break;
+				used += read;
+			}
+			fclose(f);
+
+			return parseFeed(std::string(), contents.data(), used, feed);
+		}
+		catch (std::bad_alloc&)
+		{
+			return false;
+		}
+	}
+}}}
@@ -26,9 +26,18 @@
 #include <dom/parsers/encoding_db.hpp>
 #include <dom/parsers/html.hpp>
 #include <vector>
+#include <algorithm>
 #include <utils.hpp>
 #include <dom/dom.hpp>
+#include <libweb/alloc_scope.hpp>
 #include <cstring>
+#include "../tape/tape.hpp"
+#include "transcoder.hpp"
+#include "utf8_validator.hpp"
+#include "prescan.hpp"
+#include "parser_pool.hpp"
+#include "limits.hpp"
+#include "void_elements.hpp"
 
 namespace google
 {
@@ -109,6 +118,42 @@ namespace utf8
 	{
 		return fromUtf32(c.data(), c.size());
 	}
+
+	inline std::string fromUtf16(const char* data, size_t size, bool bigEndian)
+	{
+		auto bytes = (const unsigned char*)data;
+		size_t count = size / 2;
+
+		std::string utf8;
+		utf8.reserve(count * 3 / 2);
+
+		auto unit = [&](size_t i) -> uint32_t
+		{
+			return bigEndian ? (bytes[2 * i] << 8) | bytes[2 * i + 1] : (bytes[2 * i + 1] << 8) | bytes[2 * i];
+		};
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t utf32 = unit(i);
+			if (utf32 >= 0xD800 && utf32 < 0xDC00 && i + 1 < count)
+			{
+				uint32_t low = unit(i + 1);
+				if (low >= 0xDC00 && low < 0xE000)
+				{
+					utf32 = 0x10000 + ((utf32 - 0xD800) << 10) + (low - 0xDC00);
+					++i;
+				}
+				else
+					utf32 = unicodeReplacement;
+			}
+			else if (utf32 >= 0xD800 && utf32 < 0xE000)
+				utf32 = unicodeReplacement;
+
+			conv(utf8, utf32);
+		}
+
+		return utf8;
+	}
 }
 
 namespace dom { namespace parsers { namespace html {
@@ -116,55 +161,80 @@ namespace dom { namespace parsers { namespace html {
 	struct TextConverter
 	{
 		virtual ~TextConverter() {}
-		virtual std::string conv(const std::string&) = 0;
+		virtual std::string conv(const char* data, size_t size) = 0;
+		std::string conv(const std::string& s) { return conv(s.data(), s.length()); }
 	};
 	using TextConverterPtr = std::shared_ptr<TextConverter>;
 
 	struct Identity : TextConverter
 	{
-		std::string conv(const std::string& s) override { return s; }
+		std::string conv(const char* data, size_t size) override { return std::string(data, size); }
 	};
 
 	struct eXpatConverter : TextConverter
 	{
-		int map[256];
+		TranscoderPtr transcoder;
 
-		std::string conv(const std::string& s) override
+		std::string conv(const char* data, size_t size) override
 		{
-			std::vector<uint32_t> data;
-
-			data.reserve(s.length());
-			for (auto&& c : s)
-			{
-				uint32_t utf32 = map[(unsigned char)c];
-				if (utf32 < 0)
-					utf32 = utf8::unicodeReplacement;
-				data.push_back(utf32);
-			}
-			return utf8::fromUtf32(data);
+			return transcoder->conv(data, size);
 		}
 
 		static TextConverterPtr create(const std::string& cp)
 		{
-			auto conv = std::make_shared<eXpatConverter>();
-			if (!conv)
-				return nullptr;
-
-			if (!loadCharset(cp, conv->map))
+			auto transcoder = Transcoder::get(cp);
+			if (!transcoder)
 				return nullptr;
 
+			auto conv = std::make_shared<eXpatConverter>();
+			conv->transcoder = transcoder;
 			return conv;
 		}
 	};
 
-	class Parser : public parsers::Parser
+	// Brings the document to UTF-8 for Gumbo. The charset is taken from
+	// the BOM, the hint (e.g. from the HTTP Content-Type) or the <meta>
+	// prescan, in that order. The converter is kept for the next document.
+	//
+	// The declared charset is not taken at its word: input, which already
+	// is valid UTF-8, is passed through, whatever the label says, and the
+	// stray bytes in a "UTF-8" page are read as windows-1252.
+	class Decoder
 	{
-		dom::ElementPtr elem;
-		dom::DocumentFragmentPtr container;
-		std::string text;
 		std::string encoding;
 		TextConverterPtr converter;
-		std::string conv(const std::string& s) { return converter->conv(s); }
+
+		static bool repair(const char* data, size_t size, size_t valid, std::string& storage)
+		{
+			auto fallback = Transcoder::get("windows-1252");
+			if (!fallback)
+				return false; // Gumbo will put U+FFFD there
+
+			storage.clear();
+			storage.reserve(size + size / 8);
+			while (true)
+			{
+				storage.append(data, valid);
+				data += valid;
+				size -= valid;
+				if (!size)
+					break;
+
+				fallback->conv(data, 1, storage);
+				++data;
+				--size;
+				valid = validUtf8(data, size);
+			}
+			return true;
+		}
+
+	public:
+		Decoder()
+			: encoding("utf-8")
+			, converter(std::make_shared<Identity>())
+		{
+		}
+
 		bool switchConv(std::string cp)
 		{
 			std::tolower(cp);
@@ -172,7 +242,10 @@ namespace dom { namespace parsers { namespace html {
 				return true;
 
 			if (cp.empty() || cp == "utf-8" || cp == "utf8")
+			{
+				cp = "utf-8";
 				converter = std::make_shared<Identity>();
+			}
 			else
 				converter = eXpatConverter::create(cp);
 
@@ -181,113 +254,121 @@ namespace dom { namespace parsers { namespace html {
 			return !!converter;
 		}
 
-		inline void expand(const char* entity, const char* val)
+		// data and size are moved to the UTF-8 text, which is either the
+		// original buffer or the storage
+		void decode(const std::string& hint, const char*& data, size_t& size, std::string& storage)
 		{
-			std::string::size_type len = strlen(entity);
-			std::string::size_type ntity = text.find(entity);
-			while (ntity != std::string::npos)
+			std::string cp;
+			size_t bom = prescan::bom(data, size, cp);
+			if (!bom && !(hint.length() && switchConv(hint)))
 			{
-				text = text.substr(0, ntity) + val + text.substr(ntity + len);
-				ntity = text.find(entity, ntity);
+				if (!prescan::meta(data, size, cp) || !switchConv(cp))
+					switchConv("utf-8");
 			}
-		}
 
-		inline void expandNumericals()
-		{
-			std::string::size_type ntity = text.find("&#");
-			while (ntity != std::string::npos)
-			{
-				std::string::size_type ptr = ntity + 2;
-				char hex = text[ptr];
-
-				uint32_t utf32 = 0;
-				if (hex == 'x' || hex == 'X')
-				{
-					++ptr;
+			// a BOM wins over any label; utf-16 has no converter, it is
+			// read below
+			if (bom)
+				switchConv(cp);
 
-					while (isxdigit((unsigned char)text[ptr]))
-					{
-						switch (text[ptr])
-						{
-						case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-							utf32 *= 16;
-							utf32 += text[ptr] - 'A' + 10;
-							break;
-						case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
-							utf32 *= 16;
-							utf32 += text[ptr] - 'a' + 10;
-							break;
-						default:
-							utf32 *= 10;
-							utf32 += text[ptr] - '0';
-						};
-
-						++ptr;
-					}
-				}
-				else
-				while (isdigit((unsigned char)text[ptr]))
-				{
-					utf32 *= 10;
-					utf32 += text[ptr] - '0';
-					++ptr;
-				}
+			data += bom;
+			size -= bom;
+			if (bom && cp != "utf-8")
+			{
+				storage = utf8::fromUtf16(data, size, cp == "utf-16be");
+				data = storage.c_str();
+				size = storage.length();
+			}
+			else if (!bom)
+			{
+				size_t valid = validUtf8(data, size);
+				if (valid == size)
+					return;
 
-				if (text[ptr] == ';')
+				if (encoding == "utf-8")
 				{
-					++ptr;
-					if (utf32 == 0xA0) utf32 = ' ';
-					text = text.substr(0, ntity) + utf8::fromUtf32(utf32) + text.substr(ptr);
+					if (!repair(data, size, valid, storage))
+						return;
 				}
 				else
-					ntity += 2; //to skip this &# in the next find
-
-				ntity = text.find("&#", ntity);
-			}
-		};
-
-		inline void addText()
-		{
-			if (text.empty()) return;
-
-			text = conv(text);
-
-			expand("&nbsp;", " ");
-			expand("&quot;", "\"");
-			expand("&lt;", "<");
-			expand("&gt;", ">");
-			expandNumericals();
-			expand("&amp;", "&");
+					storage = converter->conv(data, size);
 
-			dom::TextPtr node = doc->createTextNode(text);
-			if (node)
-			{
-				if (elem)
-					elem->appendChild(node);
-				else
-					container->appendChild(node);
+				data = storage.c_str();
+				size = storage.length();
 			}
-			text.clear();
 		}
+	};
+
+	class Parser : public parsers::Parser
+	{
+		dom::DocumentFragmentPtr container;
+		std::string hint;
+		Decoder decoder;
 
 		dom::DocumentPtr doc;
+		DOCUMENT_MODE mode;
+		Projection::Matcher matcher;
+		bool projected;
+		LimitCounter limits;
 
 	public:
 
 		Parser()
-			: converter(std::make_shared<Identity>())
+			: mode(MUTABLE_DOCUMENT)
+			, projected(false)
+		{
+		}
+
+		// The cp is only a hint (e.g. from the HTTP Content-Type); the
+		// actual encoding is decided in onData, before Gumbo sees the text
+		bool create(const std::string& cp, DOCUMENT_MODE mode)
 		{
+			this->mode = mode;
+			hint = cp;
+			return newDocument();
 		}
 
-		bool create(const std::string& cp)
+		bool newDocument()
 		{
+			if (mode == READONLY_DOCUMENT)
+				return true;
+
 			doc = dom::Document::create();
 			if (!doc)
 				return false;
+			if (mode == POOLED_DOCUMENT)
+				doc->enableStringPool();
 			container = doc->createDocumentFragment();
-			if (!container)
-				return false;
-			return switchConv(cp);
+			return !!container;
+		}
+
+		// The converter stays; it is only replaced, if the next document
+		// turns out to be in a different charset. The new document is
+		// created when the data comes.
+		bool reset(const std::string& cp) override
+		{
+			container.reset();
+			doc.reset();
+			hint = cp;
+			matcher.reset();
+			limits.setLimits(Limits(), nullptr);
+			return true;
+		}
+
+		void setProjection(const Projection& projection)
+		{
+			matcher = Projection::Matcher(projection);
+			projected = !projection.empty();
+		}
+
+		void setLimits(const Limits& limits, const CancellationTokenPtr& token) override
+		{
+			this->limits.setLimits(limits, token);
+		}
+
+		PARSE_ERROR lastError() const override
+		{
+			return limits.error();
 		}
 
 		template <typename T>
@@ -306,49 +387,68 @@ namespace dom { namespace parsers { namespace html {
 			return std::string(text.data, text.length);
 		}
 
-		static bool textFromGumbo(const std::shared_ptr<dom::ParentNode>& parent, google::GumboText* text)
+		static std::string tagName(google::GumboElement* element)
+		{
+			return element->tag_namespace == google::GUMBO_NAMESPACE_HTML ?
+				google::gumbo_normalized_tagname(element->tag) : gumbo_string(element->original_tag);
+		}
+
+		static dom::ElementPtr createElement(const std::shared_ptr<dom::ParentNode>& parent, google::GumboElement* element)
+		{
+			auto doc = parent->ownerDocument();
+			if (!doc)
+				return nullptr;
+			auto e = doc->createElement(tagName(element));
+			if (!e)
+				return nullptr;
+			parent->append(e);
+
+			for (auto&& attr : gumbo_vector<google::GumboAttribute*>{ element->attributes })
+			{
+				e->setAttribute(attr->name, attr->value);
+			}
+
+			return e;
+		}
+
+		static bool textFromGumbo(LimitCounter& limits, const std::shared_ptr<dom::ParentNode>& parent, google::GumboText* text)
 		{
-			return parent->append(text->text);
+			size_t length = strlen(text->text);
+			if (!limits.text(length))
+				return false;
+			return parent->append(std::string(text->text, length));
 		}
 
-		static bool elementFromGumbo(const std::shared_ptr<dom::ParentNode>& parent, google::GumboElement* element)
+		static bool elementFromGumbo(LimitCounter& limits, const std::shared_ptr<dom::ParentNode>& parent, google::GumboElement* element)
 		{
 			if (!element->original_tag.length) // algorithmical
 			{
 				for (auto&& node : gumbo_vector<google::GumboNode*>{ element->children })
 				{
-					if (!fromGumbo(parent, node))
+					if (!fromGumbo(limits, parent, node))
 						return false;
 				}
 				return true;
 			}
 
-			std::string tagName = element->tag_namespace == google::GUMBO_NAMESPACE_HTML ?
-				google::gumbo_normalized_tagname(element->tag) : gumbo_string(element->original_tag);
-
-			auto doc = parent->ownerDocument();
-			if (!doc)
+			if (!limits.enter(element->attributes.length))
 				return false;
-			auto e = doc->createElement(tagName);
+
+			auto e = createElement(parent, element);
 			if (!e)
 				return false;
-			parent->append(e);
-
-			for (auto&& attr : gumbo_vector<google::GumboAttribute*>{ element->attributes })
-			{
-				e->setAttribute(attr->name, attr->value);
-			}
 
 			for (auto&& node : gumbo_vector<google::GumboNode*>{ element->children })
 			{
-				if (!fromGumbo(e, node))
+				if (!fromGumbo(limits, e, node))
 					return false;
 			}
 
+			limits.leave();
 			return true;
 		}
 
-		static bool fromGumbo(const std::shared_ptr<dom::ParentNode>& parent, google::GumboNode* node)
+		static bool fromGumbo(LimitCounter& limits, const std::shared_ptr<dom::ParentNode>& parent, google::GumboNode* node)
 		{
 			if (!node)
 				return false;
@@ -356,100 +456,263 @@ namespace dom { namespace parsers { namespace html {
 			switch (node->type)
 			{
 			case google::GUMBO_NODE_ELEMENT:
-				return elementFromGumbo(parent, &node->v.element);
+				return elementFromGumbo(limits, parent, &node->v.element);
+			case google::GUMBO_NODE_TEXT:
+			case google::GUMBO_NODE_CDATA:
+			case google::GUMBO_NODE_WHITESPACE:
+				return textFromGumbo(limits, parent, &node->v.text);
+			}
+
+			return true;
+		}
+
+		static bool tapeFromGumbo(LimitCounter& limits, tape::Builder& builder, google::GumboNode* node)
+		{
+			switch (node->type)
+			{
+			case google::GUMBO_NODE_ELEMENT:
+				break;
 			case google::GUMBO_NODE_TEXT:
 			case google::GUMBO_NODE_CDATA:
 			case google::GUMBO_NODE_WHITESPACE:
-				return textFromGumbo(parent, &node->v.text);
+			{
+				size_t length = strlen(node->v.text.text);
+				if (!limits.text(length))
+					return false;
+				builder.text(node->v.text.text, length);
+				return true;
+			}
+			default:
+				return true;
+			}
+
+			auto element = &node->v.element;
+			if (!element->original_tag.length) // algorithmical
+			{
+				for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
+				{
+					if (!tapeFromGumbo(limits, builder, child))
+						return false;
+				}
+				return true;
+			}
+
+			if (!limits.enter(element->attributes.length))
+				return false;
+
+			startTapeElement(builder, element);
+
+			for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
+			{
+				if (!tapeFromGumbo(limits, builder, child))
+					return false;
 			}
 
+			builder.endElement();
+			limits.leave();
 			return true;
 		}
 
-		static bool breakContentType(std::string content, std::string& charset)
+		// Projection: the elements on the path to a kept one are only
+		// remembered, until one of their descendants turns out to be needed
+		struct Ancestor
+		{
+			google::GumboElement* element;
+			dom::ElementPtr node;
+		};
+		std::vector<Ancestor> ancestors;
+
+		std::shared_ptr<dom::ParentNode> materialize()
 		{
-			std::string::size_type semi = content.find(';');
-			std::string::size_type len = content.length();
-			while (semi != std::string::npos)
+			std::shared_ptr<dom::ParentNode> parent = container;
+			for (auto&& ancestor : ancestors)
 			{
-				++semi;
-				while (semi < len && isspace((unsigned char)content[semi])) ++semi;
-				if (std::tolower(content.substr(semi, 7)) == "charset")
+				if (!ancestor.node)
 				{
-					semi += 7;
-					while (semi < len && isspace((unsigned char)content[semi])) ++semi;
-					if (semi < len && content[semi] == '=')
-					{
-						++semi;
-						std::string::size_type last = content.find(';', semi);
-						if (last == std::string::npos)
-							charset = content.substr(semi);
-						else
-							charset = content.substr(semi, last - semi);
-						std::trim(charset);
-						std::tolower(charset);
+					// counted now, that it is a part of the document
+					if (!limits.enter(ancestor.element->attributes.length))
+						return nullptr;
+					ancestor.node = createElement(parent, ancestor.element);
+					if (!ancestor.node)
+						return nullptr;
+				}
+				parent = ancestor.node;
+			}
+			return parent;
+		}
 
-						return true;
+		bool projectGumbo(google::GumboNode* node)
+		{
+			// text outside of the kept elements is not needed
+			if (node->type != google::GUMBO_NODE_ELEMENT)
+				return true;
+
+			auto element = &node->v.element;
+			if (!element->original_tag.length) // algorithmical
+			{
+				for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
+				{
+					if (!projectGumbo(child))
+						return false;
+				}
+				return true;
+			}
+
+			bool success = true;
+			switch (matcher.enter(tagName(element)))
+			{
+			case Projection::SKIP:
+				break;
+			case Projection::PATH:
+			{
+				Ancestor ancestor = { element, nullptr };
+				ancestors.push_back(ancestor);
+				for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
+				{
+					if (!projectGumbo(child))
+					{
+						success = false;
+						break;
 					}
 				}
-				semi = content.find(';', semi);
+				if (success && ancestors.back().node)
+					limits.leave();
+				ancestors.pop_back();
+				break;
+			}
+			case Projection::KEEP:
+			{
+				auto parent = materialize();
+				success = parent && elementFromGumbo(limits, parent, element);
+				break;
+			}
 			}
 
-			return false;
+			matcher.leave();
+			return success;
+		}
+
+		struct TapeAncestor
+		{
+			google::GumboElement* element;
+			bool created;
+		};
+		std::vector<TapeAncestor> tapeAncestors;
+
+		static void startTapeElement(tape::Builder& builder, google::GumboElement* element)
+		{
+			if (element->tag_namespace == google::GUMBO_NAMESPACE_HTML)
+				builder.startElement(google::gumbo_normalized_tagname(element->tag));
+			else
+				builder.startElement(gumbo_string(element->original_tag).c_str());
+
+			for (auto&& attr : gumbo_vector<google::GumboAttribute*>{ element->attributes })
+				builder.attribute(attr->name, attr->value);
 		}
 
-		static bool findEncoding(google::GumboElement* e, std::string& out)
+		bool projectTape(tape::Builder& builder, google::GumboNode* node)
 		{
-			if (e->tag == google::GUMBO_TAG_META)
+			if (node->type != google::GUMBO_NODE_ELEMENT)
+				return true;
+
+			auto element = &node->v.element;
+			if (!element->original_tag.length) // algorithmical
 			{
-				auto attr = google::gumbo_get_attribute(&e->attributes, "http-equiv");
-				if (attr && std::tolower(attr->value) == "content-type")
+				for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
 				{
-					attr = google::gumbo_get_attribute(&e->attributes, "content");
-					if (attr)
-						return breakContentType(attr->value, out);
+					if (!projectTape(builder, child))
+						return false;
 				}
+				return true;
 			}
 
-			for (auto&& node : gumbo_vector<google::GumboNode*>{ e->children })
+			bool success = true;
+			switch (matcher.enter(tagName(element)))
 			{
-				if (node->type != google::GUMBO_NODE_ELEMENT)
-					continue;
-
-				if (findEncoding(&node->v.element, out))
-					return true;
+			case Projection::SKIP:
+				break;
+			case Projection::PATH:
+			{
+				TapeAncestor ancestor = { element, false };
+				tapeAncestors.push_back(ancestor);
+				for (auto&& child : gumbo_vector<google::GumboNode*>{ element->children })
+				{
+					if (!projectTape(builder, child))
+					{
+						success = false;
+						break;
+					}
+				}
+				if (success && tapeAncestors.back().created)
+				{
+					builder.endElement();
+					limits.leave();
+				}
+				tapeAncestors.pop_back();
+				break;
+			}
+			case Projection::KEEP:
+				for (auto&& ancestor : tapeAncestors)
+				{
+					if (ancestor.created)
+						continue;
+					if (!limits.enter(ancestor.element->attributes.length))
+					{
+						success = false;
+						break;
+					}
+					startTapeElement(builder, ancestor.element);
+					ancestor.created = true;
+				}
+				success = success && tapeFromGumbo(limits, builder, node);
+				break;
 			}
 
-			return false;
+			matcher.leave();
+			return success;
 		}
 
 		bool supportsChunks() const override { return false; }
 		bool onData(const void* begin, size_t size) override
 		{
-			auto output = google::gumbo_parse_with_options(&google::kGumboDefaultOptions, (const char*)begin, size);
-			if (!output)
+			// Gumbo cannot be stopped halfway, so the input is checked
+			// before it starts; the rest is checked while building
+			if (!limits.input(size))
 				return false;
 
-			std::string encoding, newText;
-			auto found = findEncoding(&output->root->v.element, encoding);
-			if (found && encoding != this->encoding)
+			if (!doc && !newDocument())
+				return limits.parseFailed();
+
+			auto data = (const char*)begin;
+			std::string newText;
+			decoder.decode(hint, data, size, newText);
+
+			auto output = google::gumbo_parse_with_options(&google::kGumboDefaultOptions, data, size);
+			if (!output)
+				return limits.parseFailed();
+
+			if (mode == READONLY_DOCUMENT)
 			{
-				// restart
+				tape::Builder builder;
+				auto success = projected ? projectTape(builder, output->root) : tapeFromGumbo(limits, builder, output->root);
 				google::gumbo_destroy_output(&google::kGumboDefaultOptions, output);
 
-				switchConv(encoding);
-				newText = conv(std::string((const char*)begin, size));
-
-				output = google::gumbo_parse_with_options(&google::kGumboDefaultOptions, newText.c_str(), newText.length());
-				if (!output)
+				if (!success)
 					return false;
+
+				doc = builder.finish();
+				return !!doc || limits.parseFailed();
 			}
 
-			auto success = fromGumbo(container, output->root);
+			auto success = projected ? projectGumbo(output->root) : fromGumbo(limits, container, output->root);
 			google::gumbo_destroy_output(&google::kGumboDefaultOptions, output);
 
 			if (!success)
-				return false;
+			{
+				container.reset();
+				doc.reset();
+				return limits.parseFailed();
+			}
 
 			auto list = container->childNodes();
 			if (list)
@@ -476,12 +739,12 @@ namespace dom { namespace parsers { namespace html {
 		}
 	};
 
-	ParserPtr create(const std::string& encoding)
+	ParserPtr create(const std::string& encoding, DOCUMENT_MODE mode)
 	{
 		try
 		{
 			auto parser = std::make_shared<Parser>();
-			if (!parser->create(encoding))
+			if (!parser->create(encoding, mode))
 				return nullptr;
 
 			return parser;
@@ -492,81 +755,795 @@ namespace dom { namespace parsers { namespace html {
 		}
 	}
 
-	void serializeChildren(OutStream& stream, const NodePtr& node)
+	ParserPtr create(const std::string& encoding, const Projection& projection, DOCUMENT_MODE mode)
 	{
-		for (auto&& child : list_nodes(node->childNodes()))
-			serialize(stream, child);
+		try
+		{
+			auto parser = std::make_shared<Parser>();
+			if (!parser->create(encoding, mode))
+				return nullptr;
+
+			parser->setProjection(projection);
+			return parser;
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
 	}
 
-	static const char* closed[] = {
-		"area",
-		"base",
-		"basefont",
-		"br",
-		"col",
-		"frame",
-		"hr",
-		"img",
-		"input",
-		"isindex",
-		"link",
-		"meta",
-		"param",
-		"nextid",
-		"bgsound",
-		"embed",
-		"keygen",
-		"spacer",
-		"wbr"
-	};
+	DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size, DOCUMENT_MODE mode)
+	{
+		LIBWEB_ALLOC_SCOPE("html::parseDocument");
+		return ParserPool<Parser>::parse(encoding, data, size, mode, create);
+	}
 
-	void serializeElement(OutStream& stream, const ElementPtr& e)
+	DocumentFragmentPtr parseFragment(const DocumentPtr& doc, const char* data, size_t size, const std::string& context)
 	{
-		auto tag = std::tolower(e->tagName());
+		LIBWEB_ALLOC_SCOPE("html::parseFragment");
 
-		stream << '<' << tag;
+		if (!doc)
+			return nullptr;
 
-		for (auto&& att : dom::list_atts(e->getAttributes()))
-		{
-			if (!att) continue;
+		auto fragment = doc->createDocumentFragment();
+		if (!fragment)
+			return nullptr;
 
-			stream << ' '<< std::tolower(att->name()) << "=\"" << url::htmlQuotes(att->value()) << '"';
-		}
+		auto tag = google::gumbo_tag_enum(context.c_str());
+		if (tag == google::GUMBO_TAG_UNKNOWN)
+			tag = google::GUMBO_TAG_BODY;
 
-		for (auto&& name : closed)
+		google::GumboOptions options = google::kGumboDefaultOptions;
+		options.fragment_context = tag;
+		options.fragment_namespace = google::GUMBO_NAMESPACE_HTML;
+		options.max_errors = 0; // nobody reads them
+
+		auto output = google::gumbo_parse_with_options(&options, data, size);
+		if (!output)
+			return nullptr;
+
+		// the fragment's nodes are the children of the synthetic root
+		LimitCounter limits;
+		bool success = true;
+		if (output->root && output->root->type == google::GUMBO_NODE_ELEMENT)
 		{
-			if (tag == name)
+			try
 			{
-				stream << "/>";
-				return;
+				for (auto&& node : Parser::gumbo_vector<google::GumboNode*>{ output->root->v.element.children })
+				{
+					if (!Parser::fromGumbo(limits, fragment, node))
+					{
+						success = false;
+						break;
+					}
+				}
+			}
+			catch (std::bad_alloc&)
+			{
+				success = false;
 			}
 		}
 
-		stream << '>';
-		serializeChildren(stream, e);
-		stream << "</" << tag << '>';
+		google::gumbo_destroy_output(&options, output);
+		return success ? fragment : nullptr;
 	}
 
-	void serializeText(OutStream& stream, const TextPtr& t)
+	namespace
 	{
-		stream << url::htmlQuotes(t->data());
-	}
+		inline char lower(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+		}
 
-	void serialize(OutStream& stream, const dom::NodePtr& node)
-	{
-		if (!node)
+		void putLower(OutStream& stream, const string_view& name)
+		{
+			auto it = name.begin(), end = name.end();
+			for (; it != end; ++it)
+			{
+				if (*it >= 'A' && *it <= 'Z')
+					break;
+			}
+
+			if (it == end)
+			{
+				stream.puts(name.data(), name.size());
+				return;
+			}
+
+			for (auto c : name)
+				stream.putc(lower(c));
+		}
+
+		// escapes the same characters as url::htmlQuotes, but writes
+		// the unescaped runs straight from the source
+		void putEscaped(OutStream& stream, const string_view& text)
+		{
+			const char* run = text.data();
+			const char* end = run + text.size();
+			for (const char* ptr = run; ptr != end; ++ptr)
+			{
+				const char* entity = nullptr;
+				size_t length = 0;
+				switch (*ptr)
+				{
+				case '&': entity = "&amp;"; length = 5; break;
+				case '<': entity = "&lt;"; length = 4; break;
+				case '>': entity = "&gt;"; length = 4; break;
+				case '"': entity = "&quot;"; length = 6; break;
+				default:
+					continue;
+				}
+
+				if (ptr != run)
+					stream.puts(run, ptr - run);
+				stream.puts(entity, length);
+				run = ptr + 1;
+			}
+
+			if (end != run)
+				stream.puts(run, end - run);
+		}
+
+		struct AttributeWriter : AttributeVisitor
+		{
+			OutStream& stream;
+			explicit AttributeWriter(OutStream& stream) : stream(stream) {}
+
+			void onAttribute(const string_view& name, const string_view& value) override
+			{
+				stream.putc(' ');
+				putLower(stream, name);
+				stream.puts("=\"", 2);
+				putEscaped(stream, value);
+				stream.putc('"');
+			}
+		};
+
+		void serializeNode(OutStream& stream, const NodePtr& node);
+
+		void serializeChildren(OutStream& stream, const NodePtr& node)
+		{
+			for (auto child = node->firstChild(); child; child = child->nextSibling())
+				serializeNode(stream, child);
+		}
+
+		void serializeElement(OutStream& stream, const ElementPtr& e)
+		{
+			auto tag = e->nodeNameView();
+
+			stream.putc('<');
+			putLower(stream, tag);
+
+			AttributeWriter writer(stream);
+			e->visitAttributes(writer);
+
+			if (isVoidElement(tag))
+			{
+				stream.puts("/>", 2);
+				return;
+			}
+
+			stream.putc('>');
+			serializeChildren(stream, e);
+			stream.puts("</", 2);
+			putLower(stream, tag);
+			stream.putc('>');
+		}
+
+		void serializeDocument(OutStream& stream, const DocumentPtr& doc)
+		{
+			// the impl document reports only the documentElement as its
+			// child, even when the content lives in a fragment
+			auto fragment = doc->associatedFragment();
+			if (fragment)
+				return serializeChildren(stream, fragment);
+
+			serializeChildren(stream, doc);
+		}
+
+		void serializeNode(OutStream& stream, const NodePtr& node)
+		{
+			switch (node->nodeType())
+			{
+			case dom::TEXT_NODE:
+				return putEscaped(stream, std::static_pointer_cast<dom::Text>(node)->dataView());
+			case dom::ELEMENT_NODE:
+				return serializeElement(stream, std::static_pointer_cast<dom::Element>(node));
+			case dom::DOCUMENT_NODE:
+				return serializeDocument(stream, std::static_pointer_cast<dom::Document>(node));
+			default:
+				break;
+			}
+
+			serializeChildren(stream, node);
+		}
+	}
+
+	void serialize(OutStream& stream, const dom::NodePtr& node)
+	{
+		if (!node)
 			return;
 
-		auto type = node->nodeType();
-		switch (type)
+		LIBWEB_ALLOC_SCOPE("html::serialize");
+
+		BufferedOutStream buffered(stream);
+		serializeNode(buffered, node);
+	}
+
+	namespace
+	{
+		void addLower(std::vector<std::string>& list, const std::string& name)
+		{
+			std::string lower = name;
+			std::tolower(lower);
+			list.push_back(std::move(lower));
+		}
+	}
+
+	Policy::Policy()
+	{
+		for (auto tag : { "head", "script", "style", "template", "noscript", "iframe", "object", "embed" })
+			m_dropped.push_back(tag);
+	}
+
+	Policy& Policy::allow(const std::string& tag, std::initializer_list<const char*> attributes)
+	{
+		std::string name = tag;
+		std::tolower(name);
+
+		auto it = m_tags.begin();
+		for (; it != m_tags.end(); ++it)
+		{
+			if (it->name == name)
+				break;
+		}
+
+		if (it == m_tags.end())
+		{
+			Tag item = { std::move(name), std::vector<std::string>() };
+			it = m_tags.insert(m_tags.end(), std::move(item));
+		}
+
+		for (auto attr : attributes)
+			addLower(it->attributes, attr);
+
+		return *this;
+	}
+
+	Policy& Policy::allowAttribute(const std::string& name)
+	{
+		addLower(m_attributes, name);
+		return *this;
+	}
+
+	Policy& Policy::urlAttribute(const std::string& name)
+	{
+		addLower(m_urlAttributes, name);
+		return *this;
+	}
+
+	Policy& Policy::allowScheme(const std::string& scheme)
+	{
+		addLower(m_schemes, scheme);
+		return *this;
+	}
+
+	Policy& Policy::drop(const std::string& tag)
+	{
+		addLower(m_dropped, tag);
+		return *this;
+	}
+
+	Policy Policy::feed()
+	{
+		Policy policy;
+		for (auto tag : {
+			"abbr", "b", "blockquote", "br", "caption", "cite", "code", "dd", "del",
+			"div", "dl", "dt", "em", "figcaption", "figure", "h1", "h2", "h3", "h4",
+			"h5", "h6", "hr", "i", "ins", "kbd", "li", "ol", "p", "pre", "s", "samp",
+			"small", "span", "strong", "sub", "sup", "table", "tbody", "tfoot",
+			"thead", "tr", "u", "ul", "var"
+		})
+			policy.allow(tag);
+
+		policy
+			.allow("a", { "href" })
+			.allow("img", { "src", "alt", "width", "height" })
+			.allow("q", { "cite" })
+			.allow("td", { "colspan", "rowspan" })
+			.allow("th", { "colspan", "rowspan" })
+			.allowAttribute("title")
+			.urlAttribute("href")
+			.urlAttribute("src")
+			.urlAttribute("cite")
+			.allowScheme("http")
+			.allowScheme("https")
+			.allowScheme("mailto");
+
+		return policy;
+	}
+
+	class GumboSanitizer : public Sanitizer
+	{
+		enum ACTION
+		{
+			UNWRAP, // the tag goes, the contents stay
+			KEEP,
+			DROP    // the tag and the contents go
+		};
+
+		// by GumboTag
+		std::vector<ACTION> actions;
+		std::vector<std::vector<std::string>> tagAttributes;
+
+		// sorted, for the binary search
+		std::vector<std::string> attributes;
+		std::vector<std::string> urlAttributes;
+		std::vector<std::string> schemes;
+
+		static std::vector<std::string> sorted(std::vector<std::string> list)
+		{
+			std::sort(list.begin(), list.end());
+			list.erase(std::unique(list.begin(), list.end()), list.end());
+			return list;
+		}
+
+		static bool contains(const std::vector<std::string>& list, const char* name)
+		{
+			auto it = std::lower_bound(list.begin(), list.end(), name, [](const std::string& item, const char* name) {
+				return strcmp(item.c_str(), name) < 0;
+			});
+			return it != list.end() && *it == name;
+		}
+
+		// Reads the scheme the way a browser would (ignoring the leading
+		// spaces and controls and the tabs and newlines inside), so that
+		// "java&#9;script:" does not get through
+		bool schemeAllowed(const char* url) const
+		{
+			while (*url && (unsigned char)*url <= ' ')
+				++url;
+
+			char scheme[32];
+			size_t length = 0;
+			for (; *url; ++url)
+			{
+				char c = *url;
+				if (c == '\t' || c == '\n' || c == '\r')
+					continue;
+
+				if (c == ':')
+				{
+					scheme[length] = 0;
+					return contains(schemes, scheme);
+				}
+
+				if (!isalnum((unsigned char)c) && c != '+' && c != '-' && c != '.')
+					return true; // relative
+
+				if (length + 1 == sizeof(scheme))
+					return false;
+				scheme[length++] = lower(c);
+			}
+
+			return true; // relative
+		}
+
+		bool attributeAllowed(google::GumboTag tag, const google::GumboAttribute* attr) const
+		{
+			if (!contains(tagAttributes[tag], attr->name) && !contains(attributes, attr->name))
+				return false;
+
+			return !contains(urlAttributes, attr->name) || schemeAllowed(attr->value);
+		}
+
+		void children(OutStream& stream, google::GumboElement* element) const
+		{
+			for (auto&& child : Parser::gumbo_vector<google::GumboNode*>{ element->children })
+				write(stream, child);
+		}
+
+		void write(OutStream& stream, google::GumboNode* node) const
+		{
+			switch (node->type)
+			{
+			case google::GUMBO_NODE_ELEMENT:
+				break;
+			case google::GUMBO_NODE_TEXT:
+			case google::GUMBO_NODE_CDATA:
+			case google::GUMBO_NODE_WHITESPACE:
+				putEscaped(stream, node->v.text.text);
+				return;
+			default:
+				return;
+			}
+
+			auto element = &node->v.element;
+			if (element->tag_namespace != google::GUMBO_NAMESPACE_HTML)
+				return;
+
+			auto action = (size_t)element->tag < actions.size() ? actions[element->tag] : UNWRAP;
+			if (action == DROP)
+				return;
+
+			if (action == UNWRAP)
+				return children(stream, element);
+
+			string_view name = google::gumbo_normalized_tagname(element->tag);
+			stream.putc('<');
+			stream.puts(name.data(), name.size());
+
+			for (auto&& attr : Parser::gumbo_vector<google::GumboAttribute*>{ element->attributes })
+			{
+				if (!attributeAllowed(element->tag, attr))
+					continue;
+
+				stream.putc(' ');
+				stream.puts(attr->name, strlen(attr->name));
+				stream.puts("=\"", 2);
+				putEscaped(stream, attr->value);
+				stream.putc('"');
+			}
+
+			if (isVoidElement(name))
+			{
+				stream.puts("/>", 2);
+				return;
+			}
+
+			stream.putc('>');
+			children(stream, element);
+			stream.puts("</", 2);
+			stream.puts(name.data(), name.size());
+			stream.putc('>');
+		}
+
+	public:
+		explicit GumboSanitizer(const Policy& policy)
+			: actions(google::GUMBO_TAG_LAST + 1, UNWRAP)
+			, tagAttributes(google::GUMBO_TAG_LAST + 1)
+			, attributes(sorted(policy.attributes()))
+			, urlAttributes(sorted(policy.urlAttributes()))
+			, schemes(sorted(policy.schemes()))
+		{
+			for (auto&& tag : policy.tags())
+			{
+				auto id = google::gumbo_tag_enum(tag.name.c_str());
+				if (id == google::GUMBO_TAG_UNKNOWN)
+					continue;
+
+				actions[id] = KEEP;
+				auto& list = tagAttributes[id];
+				list.insert(list.end(), tag.attributes.begin(), tag.attributes.end());
+				list = sorted(std::move(list));
+			}
+
+			for (auto&& tag : policy.dropped())
+			{
+				auto id = google::gumbo_tag_enum(tag.c_str());
+				if (id != google::GUMBO_TAG_UNKNOWN)
+					actions[id] = DROP;
+			}
+		}
+
+		// nothing but the compiled policy is shared between the calls
+		bool sanitize(const std::string& encoding, const void* begin, size_t size, OutStream& stream) const override
+		{
+			LIBWEB_ALLOC_SCOPE("html::sanitize");
+			auto data = (const char*)begin;
+			std::string storage;
+			Decoder decoder;
+			decoder.decode(encoding, data, size, storage);
+
+			auto output = google::gumbo_parse_with_options(&google::kGumboDefaultOptions, data, size);
+			if (!output)
+				return false;
+
+			bool success = true;
+			try
+			{
+				BufferedOutStream buffered(stream);
+				write(buffered, output->root);
+			}
+			catch (std::bad_alloc&)
+			{
+				success = false;
+			}
+
+			google::gumbo_destroy_output(&google::kGumboDefaultOptions, output);
+			return success;
+		}
+	};
+
+	SanitizerPtr createSanitizer(const Policy& policy)
+	{
+		try
+		{
+			return std::make_shared<GumboSanitizer>(policy);
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	namespace
+	{
+		enum TEXT_ROLE
+		{
+			INLINE,
+			SKIPPED,   // never visible
+			CELL,      // separated by a space
+			LINE,      // starts on a new line
+			PARAGRAPH, // separated by an empty line
+			BREAK,     // br
+			PREFORMATTED
+		};
+
+		// by GumboTag
+		const std::vector<TEXT_ROLE>& textRoles()
 		{
-		case dom::TEXT_NODE:
-			return serializeText(stream, std::static_pointer_cast<dom::Text>(node));
-		case dom::ELEMENT_NODE:
-			return serializeElement(stream, std::static_pointer_cast<dom::Element>(node));
+			static const std::vector<TEXT_ROLE> roles = [] {
+				struct Role
+				{
+					const char* name;
+					TEXT_ROLE role;
+				};
+				static const Role list[] = {
+					{ "head", SKIPPED }, { "script", SKIPPED }, { "style", SKIPPED },
+					{ "template", SKIPPED }, { "noscript", SKIPPED }, { "iframe", SKIPPED },
+					{ "object", SKIPPED }, { "select", SKIPPED },
+					{ "td", CELL }, { "th", CELL },
+					{ "address", LINE }, { "article", LINE }, { "aside", LINE },
+					{ "caption", LINE }, { "dd", LINE }, { "div", LINE }, { "dt", LINE },
+					{ "fieldset", LINE }, { "figcaption", LINE }, { "figure", LINE },
+					{ "footer", LINE }, { "form", LINE }, { "header", LINE }, { "hr", LINE },
+					{ "li", LINE }, { "main", LINE }, { "nav", LINE }, { "section", LINE },
+					{ "tr", LINE },
+					{ "blockquote", PARAGRAPH }, { "dl", PARAGRAPH }, { "h1", PARAGRAPH },
+					{ "h2", PARAGRAPH }, { "h3", PARAGRAPH }, { "h4", PARAGRAPH },
+					{ "h5", PARAGRAPH }, { "h6", PARAGRAPH }, { "ol", PARAGRAPH },
+					{ "p", PARAGRAPH }, { "table", PARAGRAPH }, { "ul", PARAGRAPH },
+					{ "br", BREAK },
+					{ "pre", PREFORMATTED }, { "textarea", PREFORMATTED },
+				};
+
+				std::vector<TEXT_ROLE> out(google::GUMBO_TAG_LAST + 1, INLINE);
+				for (auto&& item : list)
+				{
+					auto tag = google::gumbo_tag_enum(item.name);
+					if (tag != google::GUMBO_TAG_UNKNOWN)
+						out[tag] = item.role;
+				}
+				return out;
+			}();
+			return roles;
+		}
+
+		// display: none and visibility: hidden, with any spacing and case
+		bool hiddenByStyle(const char* style)
+		{
+			std::string compact;
+			for (; *style; ++style)
+			{
+				if (!isspace((unsigned char)*style))
+					compact.push_back(lower(*style));
+			}
+			return compact.find("display:none") != std::string::npos ||
+				compact.find("visibility:hidden") != std::string::npos;
+		}
+
+		bool hidden(google::GumboElement* element)
+		{
+			for (auto&& attr : Parser::gumbo_vector<google::GumboAttribute*>{ element->attributes })
+			{
+				if (!strcmp(attr->name, "hidden"))
+					return true;
+				if (!strcmp(attr->name, "aria-hidden") && !strcmp(attr->value, "true"))
+					return true;
+				if (!strcmp(attr->name, "style") && hiddenByStyle(attr->value))
+					return true;
+			}
+			return false;
 		}
 
-		serializeChildren(stream, node);
+		class TextExtractor
+		{
+			std::string& out;
+			size_t limit;
+			size_t chars;
+			size_t preformatted;
+			bool space;
+			int breaks; // pending line breaks
+			bool done;
+
+			void separate(int lines)
+			{
+				if (breaks < lines)
+					breaks = lines;
+			}
+
+			// the pending space or breaks go out only before the next
+			// visible character, so there is nothing at the ends; they
+			// count against the limit together with that character
+			bool put(char c)
+			{
+				bool lead = ((unsigned char)c & 0xC0) != 0x80;
+				if (lead)
+				{
+					size_t separator = 0;
+					if (!out.empty())
+						separator = breaks ? breaks : space ? 1 : 0;
+
+					if (limit && chars + separator + 1 > limit)
+					{
+						done = true;
+						return false;
+					}
+
+					if (breaks)
+						out.append(separator, '\n');
+					else if (separator)
+						out.push_back(' ');
+					breaks = 0;
+					space = false;
+					chars += separator + 1;
+				}
+
+				out.push_back(c);
+				return true;
+			}
+
+			void append(const char* text)
+			{
+				for (; *text && !done; ++text)
+				{
+					char c = *text;
+					if (preformatted)
+					{
+						if (c == '\n')
+							++breaks;
+						else
+							put(c);
+						continue;
+					}
+
+					if (isspace((unsigned char)c))
+						space = true;
+					else
+						put(c);
+				}
+			}
+
+		public:
+			TextExtractor(std::string& out, size_t limit)
+				: out(out)
+				, limit(limit)
+				, chars(0)
+				, preformatted(0)
+				, space(false)
+				, breaks(0)
+				, done(false)
+			{
+			}
+
+			bool limitReached() const { return done; }
+
+			void walk(google::GumboNode* node)
+			{
+				switch (node->type)
+				{
+				case google::GUMBO_NODE_ELEMENT:
+					break;
+				case google::GUMBO_NODE_TEXT:
+				case google::GUMBO_NODE_CDATA:
+				case google::GUMBO_NODE_WHITESPACE:
+					append(node->v.text.text);
+					return;
+				default:
+					return;
+				}
+
+				auto element = &node->v.element;
+				auto& roles = textRoles();
+				auto role = (size_t)element->tag < roles.size() ? roles[element->tag] : INLINE;
+				if (role == SKIPPED || hidden(element))
+					return;
+
+				switch (role)
+				{
+				case CELL: space = true; break;
+				case LINE: separate(1); break;
+				case PARAGRAPH: case PREFORMATTED: separate(2); break;
+				case BREAK: separate(1); return;
+				default: break;
+				}
+
+				if (role == PREFORMATTED)
+					++preformatted;
+
+				for (auto&& child : Parser::gumbo_vector<google::GumboNode*>{ element->children })
+				{
+					walk(child);
+					if (done)
+						return;
+				}
+
+				if (role == PREFORMATTED)
+					--preformatted;
+
+				switch (role)
+				{
+				case CELL: space = true; break;
+				case LINE: separate(1); break;
+				case PARAGRAPH: case PREFORMATTED: separate(2); break;
+				default: break;
+				}
+			}
+		};
+	}
+
+	// With a limit, the text is taken from a window at the start of the
+	// input, which is all that is decoded and parsed. The window ends
+	// before its last '<', so that no tag, reference or character is cut
+	// and its text is the start of the document's text. Only when the
+	// limit is not reached inside of it, the window grows.
+	static const size_t MIN_TEXT_WINDOW = 64 * 1024;
+	static const size_t TEXT_WINDOW_PER_CHAR = 16;
+
+	std::string extractText(const std::string& encoding, const void* begin, size_t size, size_t limit)
+	{
+		LIBWEB_ALLOC_SCOPE("html::extractText");
+
+		size_t window = size;
+		if (limit && limit < size / TEXT_WINDOW_PER_CHAR)
+			window = std::max(MIN_TEXT_WINDOW, limit * TEXT_WINDOW_PER_CHAR);
+
+		while (true)
+		{
+			bool whole = window >= size;
+			auto data = (const char*)begin;
+			size_t length = whole ? size : window;
+			std::string storage;
+			Decoder decoder;
+			decoder.decode(encoding, data, length, storage);
+
+			if (!whole)
+			{
+				while (length && data[length - 1] != '<')
+					--length;
+				if (length)
+					--length;
+			}
+
+			std::string text;
+			bool reached = false;
+			if (whole || length)
+			{
+				auto output = google::gumbo_parse_with_options(&google::kGumboDefaultOptions, data, length);
+				if (!output)
+					return std::string();
+
+				try
+				{
+					TextExtractor extractor(text, limit);
+					extractor.walk(output->root);
+					reached = extractor.limitReached();
+				}
+				catch (std::bad_alloc&)
+				{
+					text.clear();
+					reached = true;
+				}
+
+				google::gumbo_destroy_output(&google::kGumboDefaultOptions, output);
+			}
+
+			if (whole || reached)
+				return text;
+
+			window = size / 4 < window ? size : window * 4;
+		}
 	}
 
 }}}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_LIMITS_HPP__
+#define __DOM_INTERNAL_LIMITS_HPP__
+
+#include <dom/parsers/parser.hpp>
+
+namespace dom { namespace parsers {
+
+	// The running totals of a parse, checked against the Limits. An
+	// unbounded limit is kept as the largest size_t, so that every check is
+	// a single comparison.
+	class LimitCounter
+	{
+		size_t m_maxInput;
+		size_t m_maxNodes;
+		size_t m_maxDepth;
+		size_t m_maxAttributes;
+		size_t m_maxText;
+		CancellationTokenPtr m_token;
+
+		size_t m_input;
+		size_t m_nodes;
+		size_t m_depth;
+		size_t m_text;
+		PARSE_ERROR m_error;
+
+		static size_t bound(size_t limit) { return limit ? limit : (size_t)-1; }
+
+		bool fail(PARSE_ERROR error)
+		{
+			if (m_error == PARSE_OK)
+				m_error = error;
+			return false;
+		}
+
+	public:
+		LimitCounter() { setLimits(Limits(), nullptr); }
+
+		void setLimits(const Limits& limits, const CancellationTokenPtr& token)
+		{
+			m_maxInput = bound(limits.maxInputBytes);
+			m_maxNodes = bound(limits.maxNodes);
+			m_maxDepth = bound(limits.maxDepth);
+			m_maxAttributes = bound(limits.maxAttributes);
+			m_maxText = bound(limits.maxTextBytes);
+			m_token = token;
+			restart();
+		}
+
+		void restart()
+		{
+			m_input = 0;
+			m_nodes = 0;
+			m_depth = 0;
+			m_text = 0;
+			m_error = PARSE_OK;
+		}
+
+		PARSE_ERROR error() const { return m_error; }
+		bool failed() const { return m_error != PARSE_OK; }
+		// the parser itself gave up; a limit hit first keeps its error
+		bool parseFailed() { return fail(PARSE_FAILED); }
+
+		bool input(size_t bytes)
+		{
+			m_input += bytes;
+			return m_input <= m_maxInput || fail(LIMIT_INPUT);
+		}
+
+		bool enter(size_t attributes)
+		{
+			if (++m_nodes > m_maxNodes)
+				return fail(LIMIT_NODES);
+			if (++m_depth > m_maxDepth)
+				return fail(LIMIT_DEPTH);
+			if (attributes > m_maxAttributes)
+				return fail(LIMIT_ATTRIBUTES);
+			if (m_token && m_token->cancelled())
+				return fail(PARSE_CANCELLED);
+			return true;
+		}
+
+		void leave() { --m_depth; }
+
+		bool text(size_t bytes)
+		{
+			m_text += bytes;
+			return m_text <= m_maxText || fail(LIMIT_TEXT);
+		}
+	};
+}}
+
+#endif // __DOM_INTERNAL_LIMITS_HPP__
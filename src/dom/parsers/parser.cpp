@@ -24,42 +24,79 @@
 
 #include "pch.h"
 #include <dom/parsers/parser.hpp>
+#include <libweb/alloc_scope.hpp>
+#include "mapped_file.hpp"
+#include <vector>
+
 namespace dom { namespace parsers {
 
-	DocumentPtr parseFile(const ParserPtr& parser, const filesystem::path& path)
+	static const size_t CHUNK = 65536;
+
+	// Reads the file directly into the parser's own buffer; returns
+	// false, if the parser does not have one
+	static bool parseBuffered(const ParserPtr& parser, const filesystem::path& path, DocumentPtr& doc)
 	{
-		if (!parser)
-			return nullptr;
+		void* buffer = parser->dataBuffer(CHUNK);
+		if (!buffer)
+			return false;
 
 		FILE* f = fopen(path.native().c_str(), "rb");
 		if (!f)
-			return nullptr;
+			return true;
 
-		if (!parser->supportsChunks())
+		while (buffer)
 		{
-			size_t length = filesystem::file_size(path);
-			char * contents = (char*)malloc(length);
-			if (!contents)
-				return nullptr;
+			size_t read = fread(buffer, 1, CHUNK, f);
+			if (!read)
+				break;
 
-			size_t read = fread(contents, 1, length, f);
-			fclose(f);
-
-			if (!parser->onData(contents, length))
+			if (!parser->onBufferData(read))
 			{
-				free(contents);
-				return nullptr;
+				fclose(f);
+				return true;
 			}
 
-			free(contents);
-			return parser->onFinish();
+			buffer = parser->dataBuffer(CHUNK);
 		}
+		fclose(f);
 
-		char buffer[8192];
-		size_t read;
-		while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		if (buffer)
+			doc = parser->onFinish();
+		return true;
+	}
+
+	DocumentPtr parseFile(const ParserPtr& parser, const filesystem::path& path)
+	{
+		LIBWEB_ALLOC_SCOPE("parsers::parseFile");
+		if (!parser)
+			return nullptr;
+
+		DocumentPtr doc;
+		if (parser->supportsChunks() && parseBuffered(parser, path, doc))
+			return doc;
+
+		MappedFile file;
+		if (file.open(path))
+			return parseDocument(parser, file.data(), file.size());
+
+		// not a regular file, or an empty one: the chunks go to the parser
+		// as they come, or are read in place at the end of one block
+		FILE* f = fopen(path.native().c_str(), "rb");
+		if (!f)
+			return nullptr;
+
+		std::vector<char> contents;
+		size_t used = 0;
+		while (true)
 		{
-			if (!parser->onData(buffer, read))
+			contents.resize(used + CHUNK);
+			size_t read = fread(contents.data() + used, 1, CHUNK, f);
+			if (!read)
+				break;
+
+			if (!parser->supportsChunks())
+				used += read;
+			else if (!parser->onData(contents.data(), read))
 			{
 				fclose(f);
 				return nullptr;
@@ -67,6 +104,9 @@ namespace dom { namespace parsers {
 		}
 		fclose(f);
 
+		if (!parser->supportsChunks() && !parser->onData(contents.data(), used))
+			return nullptr;
+
 		return parser->onFinish();
 	}
 }}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_PARSER_POOL_HPP__
+#define __DOM_INTERNAL_PARSER_POOL_HPP__
+
+#include <dom/parsers/parser.hpp>
+#include <vector>
+
+namespace dom { namespace parsers {
+
+	// Per-thread cache of parsers, which are reset instead of being
+	// created anew for each document. The Kind keeps the XML and HTML
+	// pools apart.
+	template <typename Kind>
+	class ParserPool
+	{
+		enum { MAX_FREE = 4 };
+		std::vector<ParserPtr> m_free[READONLY_DOCUMENT + 1];
+
+		static ParserPool& local()
+		{
+			static thread_local ParserPool pool;
+			return pool;
+		}
+	public:
+		using Factory = ParserPtr(*)(const std::string& encoding, DOCUMENT_MODE mode);
+
+		static ParserPtr acquire(const std::string& encoding, DOCUMENT_MODE mode, Factory create)
+		{
+			auto& list = local().m_free[mode];
+			while (!list.empty())
+			{
+				auto parser = std::move(list.back());
+				list.pop_back();
+
+				// released parsers are already reset for the default encoding
+				if (encoding.empty() || parser->reset(encoding))
+					return parser;
+			}
+			return create(encoding, mode);
+		}
+
+		static void release(ParserPtr&& parser, DOCUMENT_MODE mode)
+		{
+			// resetting here lets go of the finished document right away
+			if (!parser || !parser->reset(std::string()))
+				return;
+
+			auto& list = local().m_free[mode];
+			if (list.size() < MAX_FREE)
+				list.push_back(std::move(parser));
+		}
+
+		static DocumentPtr parse(const std::string& encoding, const void* data, size_t size, DOCUMENT_MODE mode, Factory create)
+		{
+			auto parser = acquire(encoding, mode, create);
+			if (!parser)
+				return nullptr;
+
+			DocumentPtr doc;
+			if (parser->onData(data, size))
+				doc = parser->onFinish();
+
+			release(std::move(parser), mode);
+			return doc;
+		}
+	};
+}}
+
+#endif // __DOM_INTERNAL_PARSER_POOL_HPP__
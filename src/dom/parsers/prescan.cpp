@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "prescan.hpp"
+
+namespace dom { namespace parsers { namespace html { namespace prescan {
+
+	static inline bool isSpace(char c)
+	{
+		return c == 0x09 || c == 0x0A || c == 0x0C || c == 0x0D || c == 0x20;
+	}
+
+	static inline bool isAlpha(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+
+	static inline char lower(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+	}
+
+	static inline bool startsWith(const char* ptr, const char* end, const char* prefix)
+	{
+		for (; *prefix; ++ptr, ++prefix)
+		{
+			if (ptr == end || lower(*ptr) != *prefix)
+				return false;
+		}
+		return true;
+	}
+
+	size_t bom(const char* data, size_t size, std::string& encoding)
+	{
+		auto bytes = (const unsigned char*)data;
+		if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+		{
+			encoding = "utf-8";
+			return 3;
+		}
+		if (size >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF)
+		{
+			encoding = "utf-16be";
+			return 2;
+		}
+		if (size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE)
+		{
+			encoding = "utf-16le";
+			return 2;
+		}
+		return 0;
+	}
+
+	// "get an attribute"; returns false, if there are no more attributes in the tag
+	static bool attribute(const char*& ptr, const char* end, std::string& name, std::string& value)
+	{
+		name.clear();
+		value.clear();
+
+		while (ptr != end && (isSpace(*ptr) || *ptr == '/')) ++ptr;
+		if (ptr == end || *ptr == '>')
+			return false;
+
+		do
+		{
+			name.push_back(lower(*ptr++));
+		} while (ptr != end && *ptr != '=' && *ptr != '/' && *ptr != '>' && !isSpace(*ptr));
+
+		while (ptr != end && isSpace(*ptr)) ++ptr;
+		if (ptr == end || *ptr != '=')
+			return true;
+
+		++ptr;
+		while (ptr != end && isSpace(*ptr)) ++ptr;
+		if (ptr == end)
+			return true;
+
+		if (*ptr == '"' || *ptr == '\'')
+		{
+			char quote = *ptr++;
+			while (ptr != end && *ptr != quote)
+				value.push_back(lower(*ptr++));
+			if (ptr != end)
+				++ptr;
+			return true;
+		}
+
+		while (ptr != end && *ptr != '>' && !isSpace(*ptr))
+			value.push_back(lower(*ptr++));
+		return true;
+	}
+
+	// "extract a character encoding from a meta element"
+	static bool contentCharset(const std::string& content, std::string& charset)
+	{
+		std::string::size_type pos = 0;
+		std::string::size_type len = content.length();
+		while ((pos = content.find("charset", pos)) != std::string::npos)
+		{
+			pos += 7;
+			while (pos < len && isSpace(content[pos])) ++pos;
+			if (pos == len || content[pos] != '=')
+				continue;
+			++pos;
+			while (pos < len && isSpace(content[pos])) ++pos;
+			if (pos == len)
+				return false;
+
+			char quote = content[pos];
+			if (quote == '"' || quote == '\'')
+			{
+				auto last = content.find(quote, pos + 1);
+				if (last == std::string::npos)
+					return false;
+				charset = content.substr(pos + 1, last - pos - 1);
+			}
+			else
+			{
+				auto last = pos;
+				while (last < len && !isSpace(content[last]) && content[last] != ';') ++last;
+				charset = content.substr(pos, last - pos);
+			}
+			return !charset.empty();
+		}
+		return false;
+	}
+
+	bool meta(const char* data, size_t size, std::string& encoding)
+	{
+		const char* ptr = data;
+		const char* end = data + (size < 1024 ? size : 1024);
+		std::string name, value;
+
+		while (ptr != end)
+		{
+			if (*ptr != '<')
+			{
+				++ptr;
+				continue;
+			}
+
+			if (startsWith(ptr, end, "<!--"))
+			{
+				ptr += 4;
+				while (ptr != end && !startsWith(ptr, end, "-->")) ++ptr;
+				if (ptr != end)
+					ptr += 3;
+				continue;
+			}
+
+			if (startsWith(ptr, end, "<meta") && ptr + 5 != end && (isSpace(ptr[5]) || ptr[5] == '/'))
+			{
+				ptr += 6;
+				bool gotPragma = false, needPragma = false, hasCharset = false;
+				std::string charset;
+				while (attribute(ptr, end, name, value))
+				{
+					if (name == "http-equiv")
+					{
+						if (value == "content-type")
+							gotPragma = true;
+					}
+					else if (name == "content")
+					{
+						if (!hasCharset && contentCharset(value, charset))
+						{
+							hasCharset = true;
+							needPragma = true;
+						}
+					}
+					else if (name == "charset" && !hasCharset)
+					{
+						charset = value;
+						hasCharset = true;
+						needPragma = false;
+					}
+				}
+
+				if (!hasCharset || (needPragma && !gotPragma))
+					continue;
+
+				if (charset.compare(0, 6, "utf-16") == 0)
+					charset = "utf-8";
+				else if (charset == "x-user-defined")
+					charset = "windows-1252";
+
+				encoding = charset;
+				return true;
+			}
+
+			if (ptr + 1 != end && (isAlpha(ptr[1]) || (ptr[1] == '/' && ptr + 2 != end && isAlpha(ptr[2]))))
+			{
+				while (ptr != end && !isSpace(*ptr) && *ptr != '>') ++ptr;
+				while (attribute(ptr, end, name, value))
+					;
+				continue;
+			}
+
+			if (ptr + 1 != end && (ptr[1] == '!' || ptr[1] == '/' || ptr[1] == '?'))
+			{
+				while (ptr != end && *ptr != '>') ++ptr;
+				continue;
+			}
+
+			++ptr;
+		}
+
+		return false;
+	}
+}}}}
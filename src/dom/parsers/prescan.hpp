@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_PRESCAN_HPP__
+#define __DOM_INTERNAL_PRESCAN_HPP__
+
+#include <string>
+
+namespace dom { namespace parsers { namespace html {
+
+	// The byte-level charset detection from the HTML spec; it runs
+	// before the parser, so that Gumbo only ever sees UTF-8 input.
+	namespace prescan
+	{
+		// Returns the length of the byte order mark, if any
+		size_t bom(const char* data, size_t size, std::string& encoding);
+
+		// Looks for <meta charset> and <meta http-equiv=content-type>
+		// within the first 1024 bytes
+		bool meta(const char* data, size_t size, std::string& encoding);
+	}
+}}}
+
+#endif // __DOM_INTERNAL_PRESCAN_HPP__
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <dom/parsers/projection.hpp>
+
+namespace dom { namespace parsers {
+
+	void Projection::add(const std::string& path)
+	{
+		Path steps;
+		bool descendant = true; // relative paths match anywhere
+		std::string::size_type pos = 0, len = path.length();
+
+		if (pos < len && path[pos] == '/')
+		{
+			descendant = false;
+			++pos;
+			if (pos < len && path[pos] == '/')
+			{
+				descendant = true;
+				++pos;
+			}
+		}
+
+		while (pos < len)
+		{
+			auto slash = path.find('/', pos);
+			if (slash == std::string::npos)
+				slash = len;
+
+			if (slash == pos) // "//"
+			{
+				descendant = true;
+				++pos;
+				continue;
+			}
+
+			Step step = { path.substr(pos, slash - pos), descendant };
+			steps.push_back(std::move(step));
+			descendant = false;
+			pos = slash + 1;
+		}
+
+		if (!steps.empty())
+			m_paths.push_back(std::move(steps));
+	}
+
+	void Projection::Matcher::reset()
+	{
+		m_positions.clear();
+		m_levels.clear();
+
+		Level root = { 0, m_paths.empty() ? KEEP : PATH };
+		m_levels.push_back(root);
+		for (size_t i = 0; i < m_paths.size(); ++i)
+		{
+			Position pos = { i, 0 };
+			m_positions.push_back(pos);
+		}
+	}
+
+	static inline bool matches(const std::string& step, const string_view& name)
+	{
+		if (step == "*" || name == step)
+			return true;
+
+		// an unprefixed step matches the local name of a prefixed tag
+		if (step.find(':') != std::string::npos)
+			return false;
+		auto col = name.find(':');
+		return col != string_view::npos && name.substr(col + 1) == step;
+	}
+
+	Projection::STATE Projection::Matcher::enter(const string_view& name)
+	{
+		auto parent = m_levels.back();
+		Level level = { m_positions.size(), parent.state };
+
+		if (parent.state == PATH)
+		{
+			size_t last = m_positions.size();
+			level.state = SKIP;
+			for (size_t i = parent.first; i < last; ++i)
+			{
+				Position pos = m_positions[i];
+				auto& step = m_paths[pos.path][pos.step];
+
+				if (step.descendant)
+				{
+					// the same step may still match deeper in the tree
+					m_positions.push_back(pos);
+					level.state = PATH;
+				}
+
+				if (!matches(step.name, name))
+					continue;
+
+				if (pos.step + 1 == m_paths[pos.path].size())
+				{
+					level.state = KEEP;
+					break;
+				}
+
+				Position next = { pos.path, pos.step + 1 };
+				m_positions.push_back(next);
+				level.state = PATH;
+			}
+		}
+
+		m_levels.push_back(level);
+		return level.state;
+	}
+
+	void Projection::Matcher::leave()
+	{
+		if (m_levels.size() < 2)
+			return;
+
+		m_positions.resize(m_levels.back().first);
+		m_levels.pop_back();
+	}
+}}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "transcoder.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace dom { namespace parsers {
+
+	Transcoder::Transcoder(const int(&map)[256])
+		: m_maxLength(1)
+		, m_asciiCompatible(true)
+	{
+		for (int c = 0; c < 256; ++c)
+		{
+			uint32_t utf32 = map[c] < 0 ? 0xFFFD : (uint32_t)map[c];
+			if (utf32 > 0x10FFFF)
+				utf32 = 0xFFFD;
+
+			auto& seq = m_table[c];
+			if (utf32 < 0x80)
+			{
+				seq.length = 1;
+				seq.bytes[0] = (char)utf32;
+			}
+			else if (utf32 < 0x800)
+			{
+				seq.length = 2;
+				seq.bytes[0] = (char)(0xC0 | (utf32 >> 6));
+				seq.bytes[1] = (char)(0x80 | (utf32 & 0x3F));
+			}
+			else if (utf32 < 0x10000)
+			{
+				seq.length = 3;
+				seq.bytes[0] = (char)(0xE0 | (utf32 >> 12));
+				seq.bytes[1] = (char)(0x80 | ((utf32 >> 6) & 0x3F));
+				seq.bytes[2] = (char)(0x80 | (utf32 & 0x3F));
+			}
+			else
+			{
+				seq.length = 4;
+				seq.bytes[0] = (char)(0xF0 | (utf32 >> 18));
+				seq.bytes[1] = (char)(0x80 | ((utf32 >> 12) & 0x3F));
+				seq.bytes[2] = (char)(0x80 | ((utf32 >> 6) & 0x3F));
+				seq.bytes[3] = (char)(0x80 | (utf32 & 0x3F));
+			}
+
+			if (seq.length > m_maxLength)
+				m_maxLength = seq.length;
+
+			if (c < 0x80 && utf32 != (uint32_t)c)
+				m_asciiCompatible = false;
+		}
+	}
+
+	void Transcoder::conv(const char* data, size_t size, std::string& out) const
+	{
+		static const uint64_t highBits = 0x8080808080808080ull;
+
+		size_t start = out.length();
+		out.resize(start + size * m_maxLength);
+
+		auto src = (const unsigned char*)data;
+		auto end = src + size;
+		char* base = &out[0];
+		char* dst = base + start;
+
+		while (src != end)
+		{
+			if (m_asciiCompatible)
+			{
+				// eight bytes at a time, for as long as the bytes are ASCII
+				while (end - src >= 8)
+				{
+					uint64_t word;
+					memcpy(&word, src, 8);
+					if (word & highBits)
+						break;
+					memcpy(dst, src, 8);
+					src += 8;
+					dst += 8;
+				}
+
+				if (src == end)
+					break;
+			}
+
+			auto& seq = m_table[*src++];
+			switch (seq.length)
+			{
+			case 4: dst[3] = seq.bytes[3];
+			case 3: dst[2] = seq.bytes[2];
+			case 2: dst[1] = seq.bytes[1];
+			case 1: dst[0] = seq.bytes[0];
+			}
+			dst += seq.length;
+		}
+
+		out.resize(dst - base);
+	}
+}}
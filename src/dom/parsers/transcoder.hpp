@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_TRANSCODER_HPP__
+#define __DOM_INTERNAL_TRANSCODER_HPP__
+
+#include <memory>
+#include <string>
+
+namespace dom { namespace parsers {
+
+	class Transcoder;
+	using TranscoderPtr = std::shared_ptr<const Transcoder>;
+
+	// Single-byte charset to UTF-8 converter. The UTF-8 sequence for
+	// each of the 256 input bytes is prepared once, when the charset
+	// is loaded; all the parsers using that charset share one object.
+	class Transcoder
+	{
+		struct Sequence
+		{
+			unsigned char length;
+			char bytes[4];
+		};
+
+		Sequence m_table[256];
+		size_t m_maxLength;
+		bool m_asciiCompatible;
+
+	public:
+		explicit Transcoder(const int(&map)[256]);
+
+		void conv(const char* data, size_t size, std::string& out) const;
+		std::string conv(const char* data, size_t size) const
+		{
+			std::string out;
+			conv(data, size, out);
+			return out;
+		}
+
+		// Returns the transcoder for the charset, shared by everyone using
+		// the current version of the encoding DB; see encoding_db.cpp
+		static TranscoderPtr get(const std::string& charset);
+	};
+}}
+
+#endif // __DOM_INTERNAL_TRANSCODER_HPP__
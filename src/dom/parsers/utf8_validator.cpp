@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "utf8_validator.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UTF8_NEON
+#include <arm_neon.h>
+#endif
+
+namespace dom { namespace parsers {
+
+	namespace
+	{
+		// Returns the first byte above 0x7F, or the end
+		const unsigned char* skipAscii(const unsigned char* src, const unsigned char* end)
+		{
+#if defined(UTF8_SSE2)
+			while (end - src >= 64)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)src);
+				__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+				__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+				__m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+				if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))))
+					break;
+				src += 64;
+			}
+
+			while (end - src >= 16)
+			{
+				if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)src)))
+					break;
+				src += 16;
+			}
+#elif defined(UTF8_NEON)
+			while (end - src >= 64)
+			{
+				uint8x16_t a = vld1q_u8(src);
+				uint8x16_t b = vld1q_u8(src + 16);
+				uint8x16_t c = vld1q_u8(src + 32);
+				uint8x16_t d = vld1q_u8(src + 48);
+				if (vmaxvq_u8(vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d))) & 0x80)
+					break;
+				src += 64;
+			}
+
+			while (end - src >= 16)
+			{
+				if (vmaxvq_u8(vld1q_u8(src)) & 0x80)
+					break;
+				src += 16;
+			}
+#else
+			static const uint64_t highBits = 0x8080808080808080ull;
+			while (end - src >= 8)
+			{
+				uint64_t word;
+				memcpy(&word, src, 8);
+				if (word & highBits)
+					break;
+				src += 8;
+			}
+#endif
+
+			while (src != end && *src < 0x80)
+				++src;
+			return src;
+		}
+
+		inline bool continuation(unsigned char c) { return (c & 0xC0) == 0x80; }
+
+		// Length of the multibyte sequence at src, or 0, if it is not valid
+		size_t sequence(const unsigned char* src, const unsigned char* end)
+		{
+			unsigned char lead = *src;
+			size_t avail = end - src;
+
+			if (lead >= 0xC2 && lead <= 0xDF)
+				return avail >= 2 && continuation(src[1]) ? 2 : 0;
+
+			if (lead >= 0xE0 && lead <= 0xEF)
+			{
+				if (avail < 3 || !continuation(src[2]))
+					return 0;
+				unsigned char second = src[1];
+				unsigned char lo = lead == 0xE0 ? 0xA0 : 0x80; // overlong
+				unsigned char hi = lead == 0xED ? 0x9F : 0xBF; // surrogates
+				return second >= lo && second <= hi ? 3 : 0;
+			}
+
+			if (lead >= 0xF0 && lead <= 0xF4)
+			{
+				if (avail < 4 || !continuation(src[2]) || !continuation(src[3]))
+					return 0;
+				unsigned char second = src[1];
+				unsigned char lo = lead == 0xF0 ? 0x90 : 0x80; // overlong
+				unsigned char hi = lead == 0xF4 ? 0x8F : 0xBF; // past U+10FFFF
+				return second >= lo && second <= hi ? 4 : 0;
+			}
+
+			// continuation bytes, C0, C1 and F5..FF
+			return 0;
+		}
+	}
+
+	size_t validUtf8(const char* data, size_t size)
+	{
+		auto begin = (const unsigned char*)data;
+		auto src = begin;
+		auto end = begin + size;
+
+		while (src != end)
+		{
+			if (*src < 0x80)
+			{
+				src = skipAscii(src, end);
+				continue;
+			}
+
+			size_t length = sequence(src, end);
+			if (!length)
+				break;
+
+			src += length;
+		}
+
+		return src - begin;
+	}
+}}
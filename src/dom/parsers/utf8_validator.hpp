@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_UTF8_VALIDATOR_HPP__
+#define __DOM_INTERNAL_UTF8_VALIDATOR_HPP__
+
+#include <cstddef>
+
+namespace dom { namespace parsers {
+
+	// Returns the length of the valid prefix; the whole size, if the input
+	// is UTF-8. The rules are those of the Unicode standard (table 3-7): no
+	// overlong forms, no surrogates, nothing past U+10FFFF and no sequences
+	// cut short by the end of the input. ASCII runs are skipped with SSE2
+	// or NEON, where available.
+	size_t validUtf8(const char* data, size_t size);
+}}
+
+#endif // __DOM_INTERNAL_UTF8_VALIDATOR_HPP__
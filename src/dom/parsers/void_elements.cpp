@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "void_elements.hpp"
+
+namespace dom { namespace parsers {
+
+	namespace
+	{
+		struct VoidElement
+		{
+			const char* name;
+			size_t length;
+		};
+
+#define VOID_ELEMENT(name) { name, sizeof(name) - 1 }
+		// sorted, looked up with a binary search
+		static const VoidElement voidElements[] = {
+			VOID_ELEMENT("area"),
+			VOID_ELEMENT("base"),
+			VOID_ELEMENT("basefont"),
+			VOID_ELEMENT("bgsound"),
+			VOID_ELEMENT("br"),
+			VOID_ELEMENT("col"),
+			VOID_ELEMENT("embed"),
+			VOID_ELEMENT("frame"),
+			VOID_ELEMENT("hr"),
+			VOID_ELEMENT("img"),
+			VOID_ELEMENT("input"),
+			VOID_ELEMENT("isindex"),
+			VOID_ELEMENT("keygen"),
+			VOID_ELEMENT("link"),
+			VOID_ELEMENT("meta"),
+			VOID_ELEMENT("nextid"),
+			VOID_ELEMENT("param"),
+			VOID_ELEMENT("spacer"),
+			VOID_ELEMENT("wbr")
+		};
+#undef VOID_ELEMENT
+
+		inline char lower(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+		}
+
+		int compareLower(const string_view& tag, const VoidElement& name)
+		{
+			size_t length = tag.size() < name.length ? tag.size() : name.length;
+			for (size_t i = 0; i < length; ++i)
+			{
+				unsigned char c = lower(tag[i]);
+				unsigned char n = name.name[i];
+				if (c != n)
+					return c < n ? -1 : 1;
+			}
+			if (tag.size() == name.length)
+				return 0;
+			return tag.size() < name.length ? -1 : 1;
+		}
+	}
+
+	bool isVoidElement(const string_view& tag)
+	{
+		size_t lo = 0, hi = sizeof(voidElements) / sizeof(voidElements[0]);
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			int cmp = compareLower(tag, voidElements[mid]);
+			if (!cmp)
+				return true;
+			if (cmp < 0)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return false;
+	}
+}}
@@ -23,76 +23,391 @@
  */
 
 #include "pch.h"
-#include <dom/parsers/encoding_db.hpp>
 #include <dom/parsers/xml.hpp>
 #include <dom/dom.hpp>
-#include "expat.hpp"
+#include "expat_parser.hpp"
+#include "../tape/tape.hpp"
+#include "parser_pool.hpp"
+#include "limits.hpp"
+#include <dom/parsers/projection.hpp>
+#include <libweb/alloc_scope.hpp>
+#include <vector>
 
 namespace dom { namespace parsers { namespace xml {
 
-	class Parser : public parsers::Parser, public ::xml::ExpatBase<Parser>
+	// the file readers fill the expat's own buffer this much at a time
+	static const int CHUNK = 65536;
+
+	// Base of the document-building parsers. The Final gets only the
+	// elements inside the projection, through startElement and endElement;
+	// the ancestors of a kept element are replayed just before it.
+	template <typename Final>
+	class ParserBase : public parsers::Parser, public ExpatParser<Final>
+	{
+	protected:
+		using NamespaceDecls = std::vector<std::pair<std::string, std::string>>;
+		NamespaceDecls nsDecls;
+
+	private:
+		struct Pending
+		{
+			std::string name;
+			std::vector<std::string> attrs;
+			NamespaceDecls nsDecls;
+			bool created;
+		};
+
+		Projection::Matcher matcher;
+		std::vector<Pending> pending;
+		std::vector<const XML_Char*> replayed;
+		LimitCounter limits;
+
+		void materialize()
+		{
+			NamespaceDecls current;
+			current.swap(nsDecls);
+
+			for (auto&& elem : pending)
+			{
+				if (elem.created)
+					continue;
+
+				replayed.clear();
+				for (auto&& attr : elem.attrs)
+					replayed.push_back(attr.c_str());
+				replayed.push_back(nullptr);
+
+				nsDecls.swap(elem.nsDecls);
+				static_cast<Final*>(this)->startElement(elem.name.c_str(), replayed.data());
+				elem.created = true;
+			}
+
+			nsDecls.swap(current);
+		}
+
+	public:
+
+		bool create(const std::string& cp, DOCUMENT_MODE)
+		{
+			return ExpatParser<Final>::create(cp);
+		}
+
+		void setProjection(const Projection& projection)
+		{
+			matcher = Projection::Matcher(projection);
+		}
+
+		void setLimits(const Limits& limits, const CancellationTokenPtr& token) override
+		{
+			this->limits.setLimits(limits, token);
+		}
+
+		PARSE_ERROR lastError() const override
+		{
+			return limits.error();
+		}
+
+		string_view matchName(const XML_Char* name) { return name; }
+
+		void onStartElement(const XML_Char *name, const XML_Char **attrs)
+		{
+			if (limits.failed())
+				return;
+
+			if (!limits.enter(this->getSpecifiedAttributeCount() / 2))
+			{
+				this->stop();
+				return;
+			}
+
+			auto state = matcher.state() == Projection::PATH
+				? matcher.enter(static_cast<Final*>(this)->matchName(name))
+				: matcher.enter(string_view());
+
+			switch (state)
+			{
+			case Projection::SKIP:
+				nsDecls.clear();
+				break;
+			case Projection::PATH:
+			{
+				Pending elem;
+				elem.name = name;
+				for (; *attrs; ++attrs)
+					elem.attrs.push_back(*attrs);
+				elem.nsDecls.swap(nsDecls);
+				elem.created = false;
+				pending.push_back(std::move(elem));
+				break;
+			}
+			case Projection::KEEP:
+				if (!pending.empty())
+					materialize();
+				static_cast<Final*>(this)->startElement(name, attrs);
+				break;
+			}
+		}
+
+		void onEndElement(const XML_Char *name)
+		{
+			if (limits.failed())
+				return;
+
+			limits.leave();
+			switch (matcher.state())
+			{
+			case Projection::SKIP:
+				break;
+			case Projection::PATH:
+				if (pending.back().created)
+					static_cast<Final*>(this)->endElement(name);
+				pending.pop_back();
+				break;
+			case Projection::KEEP:
+				static_cast<Final*>(this)->endElement(name);
+				break;
+			}
+			matcher.leave();
+		}
+
+		void onCharacterData(const XML_Char *pszData, int nLength)
+		{
+			if (limits.failed())
+				return;
+
+			if (!limits.text(nLength))
+			{
+				this->stop();
+				return;
+			}
+
+			if (matcher.state() == Projection::KEEP)
+				this->text.append(pszData, nLength);
+		}
+
+		bool supportsChunks() const override { return true; }
+		bool onData(const void* data, size_t length) override
+		{
+			if (!limits.input(length))
+				return false;
+			return this->parse((const char*)data, length, false) || limits.parseFailed();
+		}
+
+		void* dataBuffer(size_t length) override
+		{
+			return this->getBuffer((int)length);
+		}
+
+		bool onBufferData(size_t length) override
+		{
+			if (!limits.input(length))
+				return false;
+			return this->parseBuffer((int)length, false) || limits.parseFailed();
+		}
+
+		// for the onFinish of the Final
+		bool finish()
+		{
+			return this->parse(nullptr, 0) || limits.parseFailed();
+		}
+
+		void enableHandlers()
+		{
+			this->enableElementHandler();
+			this->enableCharacterDataHandler();
+			this->enableUnknownEncodingHandler();
+		}
+
+		bool reset(const std::string& cp) override
+		{
+			this->text.clear();
+			nsDecls.clear();
+			pending.clear();
+			matcher.reset();
+			limits.setLimits(Limits(), nullptr);
+			if (!::xml::ExpatBase<Final>::reset(cp.empty() ? nullptr : cp.c_str()))
+				return false;
+
+			enableHandlers();
+			try
+			{
+				return static_cast<Final*>(this)->onReset();
+			}
+			catch (std::bad_alloc&)
+			{
+				return false;
+			}
+		}
+	};
+
+	class Parser : public ParserBase<Parser>
 	{
 		dom::ElementPtr elem;
-		std::string text;
 		dom::DocumentPtr doc;
+		DOCUMENT_MODE mode;
+		bool namespaces; // expat resolves the prefixes
+		std::string matched, matchedNs;
+
+		// U+0001 is not allowed anywhere in an XML 1.0 document, so it
+		// cannot be part of any URI, local name or prefix
+		static const XML_Char NS_SEP = 1;
+
+		// "uri\1local\1prefix" -> uri and "prefix:local"
+		static void splitName(const XML_Char* name, std::string& ns, std::string& qualified)
+		{
+			const XML_Char* sep = strchr(name, NS_SEP);
+			if (!sep)
+			{
+				ns.clear();
+				qualified = name;
+				return;
+			}
+
+			ns.assign(name, sep - name);
+			const XML_Char* local = sep + 1;
+			sep = strchr(local, NS_SEP);
+			if (!sep)
+			{
+				qualified = local;
+				return;
+			}
+
+			qualified = sep + 1;
+			qualified.push_back(':');
+			qualified.append(local, sep - local);
+		}
 
 		void addText()
 		{
 			if (text.empty()) return;
 			if (elem)
-				elem->appendChild(doc->createTextNode(text));
+				elem->appendChild(doc->createTextNode(std::move(text)));
 			text.clear();
 		}
 	public:
 
-		Parser() : doc(dom::Document::create()) {}
+		Parser(bool namespaces = false) : mode(MUTABLE_DOCUMENT), namespaces(namespaces) {}
 
-		bool create(const std::string& cp)
+		bool create(const std::string& cp, DOCUMENT_MODE mode)
 		{
-			if (!doc)
+			this->mode = mode;
+
+			static const XML_Char sep[] = { NS_SEP, 0 };
+			if (!ExpatParser<Parser>::create(cp, namespaces ? sep : nullptr))
 				return false;
-			return ::xml::ExpatBase<Parser>::create(cp.empty() ? nullptr : cp.c_str());
+
+			return onReset();
 		}
 
-		bool supportsChunks() const override { return true; }
-		bool onData(const void* data, size_t length) override
+		// The document is created with the first element, so that a parser
+		// waiting in the pool does not hold an empty one
+		bool onReset()
 		{
-			return parse((const char*)data, length, false);
+			elem.reset();
+			doc.reset();
+			nsDecls.clear();
+
+			if (namespaces)
+			{
+				setReturnNSTriplet();
+				enableStartNamespaceDeclHandler();
+			}
+			return true;
+		}
+
+		bool newDocument()
+		{
+			doc = dom::Document::create();
+			if (!doc)
+				return false;
+			if (mode == POOLED_DOCUMENT)
+				doc->enableStringPool();
+			return true;
 		}
+
 		DocumentPtr onFinish() override
 		{
-			if (!parse(nullptr, 0))
+			if (!finish())
 				return nullptr;
 
+			// a projection may have kept nothing
+			if (!doc && !newDocument())
+				return nullptr;
 			return doc;
 		}
 
-		bool onUnknownEncoding(const XML_Char* name, XML_Encoding* info)
+		string_view matchName(const XML_Char* name)
 		{
-			info->data = nullptr;
-			info->convert = nullptr;
-			info->release = nullptr;
+			splitName(name, matchedNs, matched);
+			return matched;
+		}
 
-			if (!loadCharset(name, info->map))
+		void onStartNamespaceDecl(const XML_Char* prefix, const XML_Char* uri)
+		{
+			// expat does not report the declarations as attributes in
+			// the namespace mode, but the DOM still keeps them
+			std::string name = "xmlns";
+			if (prefix)
 			{
-				//printf("Unknown encoding: %s\n", name);
-				return false;
+				name.push_back(':');
+				name.append(prefix);
 			}
-
-			return true;
+			nsDecls.emplace_back(std::move(name), uri ? uri : "");
 		}
 
-		void onStartElement(const XML_Char *name, const XML_Char **attrs)
+		void startElement(const XML_Char *name, const XML_Char **attrs)
 		{
+			if (!doc && !newDocument())
+			{
+				stop();
+				return;
+			}
+
 			addText();
-			auto current = doc->createElement(name);
+
+			if (!namespaces)
+			{
+				// the prefixes are resolved by the tree, once appended
+				auto current = doc->createElement(name);
+				if (!current) return;
+				for (; *attrs; attrs += 2)
+				{
+					auto attr = doc->createAttribute(attrs[0], attrs[1]);
+					if (!attr) continue;
+					current->setAttribute(attr);
+				}
+				append(current);
+				return;
+			}
+
+			std::string ns, qualified;
+			splitName(name, ns, qualified);
+			auto current = doc->createElementNS(ns, qualified);
 			if (!current) return;
+
+			// the element keeps its attributes ordered by name, whatever
+			// order they are set in
+			for (auto&& decl : nsDecls)
+			{
+				auto attr = doc->createAttribute(std::move(decl.first), std::move(decl.second));
+				if (!attr) continue;
+				current->setAttribute(attr);
+			}
+			nsDecls.clear();
+
 			for (; *attrs; attrs += 2)
 			{
-				auto attr = doc->createAttribute(attrs[0], attrs[1]);
+				splitName(attrs[0], ns, qualified);
+				auto attr = doc->createAttributeNS(ns, qualified, attrs[1]);
 				if (!attr) continue;
 				current->setAttribute(attr);
 			}
+
+			append(current);
+		}
+
+		void append(const dom::ElementPtr& current)
+		{
 			if (elem)
 				elem->appendChild(current);
 			else
@@ -100,32 +415,408 @@ namespace dom { namespace parsers { namespace xml {
 			elem = current;
 		}
 
-		void onEndElement(const XML_Char *name)
+		void endElement(const XML_Char *name)
 		{
 			addText();
 			if (!elem) return;
 			dom::NodePtr node = elem->parentNode();
 			elem = std::static_pointer_cast<dom::Element>(node);
 		}
+	};
 
-		void onCharacterData(const XML_Char *pszData, int nLength)
+	class TapeParser : public ParserBase<TapeParser>
+	{
+		tape::Builder builder;
+
+		void addText()
+		{
+			if (text.empty()) return;
+			if (builder.depth())
+				builder.text(text.c_str(), text.length());
+			text.clear();
+		}
+	public:
+
+		bool onReset()
+		{
+			builder = tape::Builder();
+			return true;
+		}
+
+		DocumentPtr onFinish() override
+		{
+			if (!finish())
+				return nullptr;
+
+			return builder.finish();
+		}
+
+		void startElement(const XML_Char *name, const XML_Char **attrs)
+		{
+			addText();
+			builder.startElement(name);
+			for (; *attrs; attrs += 2)
+				builder.attribute(attrs[0], attrs[1]);
+		}
+
+		void endElement(const XML_Char *name)
 		{
-			text += std::string(pszData, nLength);
+			addText();
+			builder.endElement();
 		}
 	};
 
-	ParserPtr create(const std::string& encoding)
+	class SaxEvents : public SaxParser, public ExpatParser<SaxEvents>
+	{
+		Handler& handler;
+		std::vector<AttributeView> attributes;
+		size_t depth;
+
+		void addText()
+		{
+			if (text.empty()) return;
+			if (depth)
+				handler.onText(text);
+			text.clear();
+		}
+	public:
+
+		SaxEvents(Handler& handler) : handler(handler), depth(0) {}
+
+		bool onData(const void* data, size_t length) override
+		{
+			return parse((const char*)data, length, false);
+		}
+
+		bool onFinish() override
+		{
+			return parse(nullptr, 0);
+		}
+
+		// reads straight into the expat's buffer, as parsers::parseFile does
+		bool onFile(FILE* f)
+		{
+			while (true)
+			{
+				void* buffer = getBuffer(CHUNK);
+				if (!buffer)
+					return false;
+
+				size_t read = fread(buffer, 1, CHUNK, f);
+				if (!read)
+					break;
+
+				if (!parseBuffer((int)read, false))
+					return false;
+			}
+			return onFinish();
+		}
+
+		void onStartElement(const XML_Char *name, const XML_Char **attrs)
+		{
+			addText();
+
+			attributes.clear();
+			for (; *attrs; attrs += 2)
+			{
+				AttributeView view = { attrs[0], attrs[1] };
+				attributes.push_back(view);
+			}
+
+			++depth;
+			handler.onStartElement(name, AttributeList(attributes.data(), attributes.size()));
+		}
+
+		void onEndElement(const XML_Char *name)
+		{
+			addText();
+			--depth;
+			handler.onEndElement(name);
+		}
+	};
+
+	// Expat pushes the events; they are queued here until the caller pulls
+	// them. All the strings are kept in one arena, which is reset every
+	// time the queue runs dry, so a long document does not pile up.
+	class PullReader : public Reader, public ExpatParser<PullReader>
+	{
+		struct Slice
+		{
+			size_t offset;
+			size_t length;
+		};
+
+		struct Event
+		{
+			EVENT type;
+			Slice name;
+			size_t attrs;
+			size_t attrCount;
+		};
+
+		std::string arena;
+		std::vector<Event> events;
+		std::vector<Slice> attrSlices;
+		std::vector<AttributeView> attrViews;
+		size_t pos; // the next event to return; the current one is at pos - 1
+		size_t depth;
+		bool finished;
+		bool failed;
+
+		FILE* file;
+
+		Slice store(const char* data, size_t length)
+		{
+			Slice slice = { arena.length(), length };
+			arena.append(data, length);
+			return slice;
+		}
+
+		Slice store(const char* data) { return store(data, strlen(data)); }
+
+		string_view view(const Slice& slice) const
+		{
+			return string_view(arena.c_str() + slice.offset, slice.length);
+		}
+
+		void push(EVENT type, const Slice& name, size_t attrs = 0, size_t attrCount = 0)
+		{
+			Event ev = { type, name, attrs, attrCount };
+			events.push_back(ev);
+		}
+
+		void addText()
+		{
+			std::string& text = ExpatParser<PullReader>::text; // hidden by Reader::text()
+			if (text.empty()) return;
+			if (depth)
+				push(EVENT_TEXT, store(text.c_str(), text.length()));
+			text.clear();
+		}
+
+		bool readChunk()
+		{
+			void* buffer = getBuffer(CHUNK);
+			if (!buffer)
+				return false;
+
+			size_t read = fread(buffer, 1, CHUNK, file);
+			if (!read)
+			{
+				fclose(file);
+				file = nullptr;
+				return onFinish();
+			}
+
+			if (!parseBuffer((int)read, false))
+				failed = true;
+			return !failed;
+		}
+
+	public:
+
+		PullReader() : pos(0), depth(0), finished(false), failed(false), file(nullptr) {}
+		~PullReader()
+		{
+			if (file)
+				fclose(file);
+		}
+
+		bool open(const filesystem::path& path)
+		{
+			file = fopen(path.native().c_str(), "rb");
+			return file != nullptr;
+		}
+
+		bool onData(const void* data, size_t length) override
+		{
+			if (finished || failed)
+				return false;
+			if (!parse((const char*)data, length, false))
+				failed = true;
+			return !failed;
+		}
+
+		bool onFinish() override
+		{
+			if (finished || failed)
+				return false;
+			finished = true;
+			if (!parse(nullptr, 0))
+				failed = true;
+			return !failed;
+		}
+
+		EVENT next() override
+		{
+			while (pos >= events.size())
+			{
+				arena.clear();
+				events.clear();
+				attrSlices.clear();
+				pos = 0;
+
+				if (failed)
+					return EVENT_ERROR;
+				if (finished)
+					return EVENT_END_DOCUMENT;
+				if (!file)
+					return EVENT_NEED_DATA;
+				if (!readChunk())
+					return EVENT_ERROR;
+			}
+
+			auto& ev = events[pos++];
+			if (ev.type == EVENT_START_ELEMENT)
+			{
+				attrViews.clear();
+				for (size_t i = 0; i < ev.attrCount; ++i)
+				{
+					AttributeView attr = {
+						view(attrSlices[ev.attrs + 2 * i]),
+						view(attrSlices[ev.attrs + 2 * i + 1])
+					};
+					attrViews.push_back(attr);
+				}
+			}
+			return ev.type;
+		}
+
+		string_view name() const override
+		{
+			if (!pos || events[pos - 1].type == EVENT_TEXT)
+				return string_view();
+			return view(events[pos - 1].name);
+		}
+
+		string_view text() const override
+		{
+			if (!pos || events[pos - 1].type != EVENT_TEXT)
+				return string_view();
+			return view(events[pos - 1].name);
+		}
+
+		AttributeList attributes() const override
+		{
+			if (!pos || events[pos - 1].type != EVENT_START_ELEMENT)
+				return AttributeList();
+			return AttributeList(attrViews.data(), attrViews.size());
+		}
+
+		void onStartElement(const XML_Char *name, const XML_Char **attrs)
+		{
+			addText();
+
+			size_t first = attrSlices.size();
+			size_t count = 0;
+			for (; *attrs; attrs += 2, ++count)
+			{
+				attrSlices.push_back(store(attrs[0]));
+				attrSlices.push_back(store(attrs[1]));
+			}
+
+			++depth;
+			push(EVENT_START_ELEMENT, store(name), first, count);
+		}
+
+		void onEndElement(const XML_Char *name)
+		{
+			addText();
+			--depth;
+			push(EVENT_END_ELEMENT, store(name));
+		}
+	};
+
+	template <typename T>
+	static inline ParserPtr createParser(const std::string& encoding, DOCUMENT_MODE mode, const Projection* projection = nullptr)
+	{
+		auto parser = std::make_shared<T>();
+		if (!parser->create(encoding, mode))
+			return nullptr;
+
+		if (projection)
+			parser->setProjection(*projection);
+
+		parser->enableHandlers();
+		return parser;
+	}
+
+	ParserPtr create(const std::string& encoding, DOCUMENT_MODE mode)
 	{
 		try
 		{
-			auto parser = std::make_shared<Parser>();
-			if (!parser->create(encoding))
+			if (mode == READONLY_DOCUMENT)
+				return createParser<TapeParser>(encoding, mode);
+
+			return createParser<Parser>(encoding, mode);
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	ParserPtr createNS(const std::string& encoding, DOCUMENT_MODE mode)
+	{
+		try
+		{
+			// the tape resolves the names on its own
+			if (mode == READONLY_DOCUMENT)
+				return createParser<TapeParser>(encoding, mode);
+
+			auto parser = std::make_shared<Parser>(true);
+			if (!parser->create(encoding, mode))
 				return nullptr;
 
-			parser->enableElementHandler();
-			parser->enableCharacterDataHandler();
-			parser->enableUnknownEncodingHandler();
+			parser->enableHandlers();
+			return parser;
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	ParserPtr create(const std::string& encoding, const Projection& projection, DOCUMENT_MODE mode)
+	{
+		try
+		{
+			if (mode == READONLY_DOCUMENT)
+				return createParser<TapeParser>(encoding, mode, &projection);
+
+			return createParser<Parser>(encoding, mode, &projection);
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
 
+	DocumentPtr parseDocument(const std::string& encoding, const void* data, size_t size, DOCUMENT_MODE mode)
+	{
+		LIBWEB_ALLOC_SCOPE("xml::parseDocument");
+		return ParserPool<Parser>::parse(encoding, data, size, mode, create);
+	}
+
+	template <typename T>
+	static inline bool enableEvents(T& parser, const std::string& encoding)
+	{
+		if (!parser.create(encoding))
+			return false;
+
+		parser.enableElementHandler();
+		parser.enableCharacterDataHandler();
+		parser.enableUnknownEncodingHandler();
+		return true;
+	}
+
+	SaxParserPtr createSax(const std::string& encoding, Handler& handler)
+	{
+		try
+		{
+			auto parser = std::make_shared<SaxEvents>(handler);
+			if (!enableEvents(*parser, encoding))
+				return nullptr;
 			return parser;
 		}
 		catch (std::bad_alloc&)
@@ -134,4 +825,56 @@ namespace dom { namespace parsers { namespace xml {
 		}
 	}
 
+	bool parseFile(const std::string& encoding, Handler& handler, const filesystem::path& path)
+	{
+		try
+		{
+			SaxEvents parser(handler);
+			if (!enableEvents(parser, encoding))
+				return false;
+
+			FILE* f = fopen(path.native().c_str(), "rb");
+			if (!f)
+				return false;
+
+			bool success = parser.onFile(f);
+			fclose(f);
+			return success;
+		}
+		catch (std::bad_alloc&)
+		{
+			return false;
+		}
+	}
+
+	ReaderPtr createReader(const std::string& encoding)
+	{
+		try
+		{
+			auto reader = std::make_shared<PullReader>();
+			if (!enableEvents(*reader, encoding))
+				return nullptr;
+			return reader;
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	ReaderPtr createReader(const std::string& encoding, const filesystem::path& path)
+	{
+		try
+		{
+			auto reader = std::make_shared<PullReader>();
+			if (!enableEvents(*reader, encoding) || !reader->open(path))
+				return nullptr;
+			return reader;
+		}
+		catch (std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
 }}}
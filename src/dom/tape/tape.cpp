@@ -0,0 +1,912 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "tape.hpp"
+#include <libweb/alloc_scope.hpp>
+#include <atomic>
+#include <string.h>
+
+namespace dom {
+	NodeListPtr createList(const std::vector<NodePtr>& list);
+};
+
+namespace dom { namespace tape {
+
+	void Tape::innerText(size_t index, std::string& out) const
+	{
+		size_t end = records[index].end;
+		for (size_t i = index + 1; i < end; ++i)
+		{
+			auto& rec = records[i];
+			if (rec.type == TEXT_NODE)
+				out.append(strings, rec.value.offset, rec.value.length);
+		}
+	}
+
+	// The node objects are created on the first visit and kept by the
+	// document, one per record; the pointers handed out share the
+	// document's reference count, so a visit allocates nothing after the
+	// first one. The readers of a tape may live on many threads, hence
+	// the atomics.
+	class Document : public dom::Document, public std::enable_shared_from_this<Document>
+	{
+		Tape m_tape;
+		std::unique_ptr<std::atomic<dom::Node*>[]> m_handles;
+
+		dom::Node* createHandle(size_t index);
+	public:
+		Document(Tape&& tape)
+			: m_tape(std::move(tape))
+			, m_handles(new std::atomic<dom::Node*>[m_tape.records.size()]())
+		{
+		}
+		~Document()
+		{
+			for (size_t i = 0; i < m_tape.records.size(); ++i)
+				delete m_handles[i].load(std::memory_order_relaxed);
+		}
+
+		const Tape& tape() const { return m_tape; }
+		NodePtr node(size_t index);
+		NodePtr find(const xpath::XPath& xpath, size_t context);
+		NodeListPtr findall(const xpath::XPath& xpath, size_t context);
+		NodeListPtr children(size_t index);
+		NodePtr parent(size_t index);
+		NodePtr previous(size_t index);
+		NodePtr next(size_t index);
+		void enumTagNames(size_t from, size_t to, const std::string& tagName, std::vector<NodePtr>& out);
+
+		std::string nodeName() const override { return nodeQName().localName; }
+		const QName& nodeQName() const override { return m_tape.qnames[m_tape.records[0].qname]; }
+		std::string nodeValue() const override { return std::string(); }
+		void nodeValue(const std::string&) override {}
+		void nodeValue(std::string&&) override {}
+		string_view nodeNameView() const override { return nodeQName().localName; }
+		string_view nodeValueView() const override { return string_view(); }
+		NODE_TYPE nodeType() const override { return DOCUMENT_NODE; }
+
+		NodePtr parentNode() override { return nullptr; }
+		NodeListPtr childNodes() override { return children(0); }
+		NodePtr firstChild() override;
+		NodePtr lastChild() override;
+		NodePtr previousSibling() override { return nullptr; }
+		NodePtr nextSibling() override { return nullptr; }
+		DocumentPtr ownerDocument() override { return shared_from_this(); }
+		bool insertBefore(const NodePtr& child, const NodePtr& before = nullptr) override { return false; }
+		bool insertBefore(const NodeListPtr& children, const NodePtr& before = nullptr) override { return false; }
+		bool appendChild(const NodePtr& newChild) override { return false; }
+		bool replaceChild(const NodePtr& newChild, const NodePtr& oldChild) override { return false; }
+		bool replaceChild(const NodeListPtr& newChildren, const NodePtr& oldChild) override { return false; }
+		bool removeChild(const NodePtr& child) override { return false; }
+		void* internalData() override { return nullptr; }
+
+		dom::ElementPtr documentElement() override;
+		void setDocumentElement(const dom::ElementPtr& elem) override {}
+		dom::DocumentFragmentPtr associatedFragment() override { return nullptr; }
+		void setFragment(const DocumentFragmentPtr& f) override {}
+		dom::ElementPtr createElement(const std::string& tagName) override { return nullptr; }
+		dom::ElementPtr createElement(std::string&& tagName) override { return nullptr; }
+		dom::TextPtr createTextNode(const std::string& data) override { return nullptr; }
+		dom::TextPtr createTextNode(std::string&& data) override { return nullptr; }
+		dom::AttributePtr createAttribute(const std::string& name, const std::string& value) override { return nullptr; }
+		dom::AttributePtr createAttribute(std::string&& name, std::string&& value) override { return nullptr; }
+		dom::ElementPtr createElementNS(const std::string& ns, const std::string& qualifiedName) override { return nullptr; }
+		dom::AttributePtr createAttributeNS(const std::string& ns, const std::string& qualifiedName, const std::string& value) override { return nullptr; }
+		dom::DocumentFragmentPtr createDocumentFragment() override { return nullptr; }
+		bool adoptNode(const NodePtr& node) override { return false; }
+		dom::NodeListPtr getElementsByTagName(const std::string& tagName) override;
+		dom::ElementPtr getElementById(const std::string& elementId) override { return nullptr; }
+		bool indexAttribute(const std::string& name) override { return false; }
+		bool hasAttributeIndex(const std::string& name) override { return false; }
+		dom::NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value) override;
+		dom::NodeListPtr getElementsByAttribute(const std::string& name, const std::string& value, const NodePtr& scope) override;
+		void enableStringPool(size_t maxTextLength) override {}
+		StringPoolStats stringPoolStats() override
+		{
+			StringPoolStats empty = { 0, 0, 0 };
+			return empty;
+		}
+		NodePtr find(const std::string& path, const Namespaces& ns) override;
+		NodeListPtr findall(const std::string& path, const Namespaces& ns) override;
+	};
+
+	template <typename Interface>
+	class NodeBase : public Interface
+	{
+	protected:
+		Document* m_doc; // kept alive by the pointers to this node
+		size_t m_index;
+
+		const Tape& tape() const { return m_doc->tape(); }
+		const Record& rec() const { return m_doc->tape().records[m_index]; }
+	public:
+		NodeBase(Document* doc, size_t index) : m_doc(doc), m_index(index) {}
+
+		std::string nodeName() const override { return tape().str(rec().name); }
+		const QName& nodeQName() const override { return tape().qnames[rec().qname]; }
+		std::string nodeValue() const override { return tape().str(rec().value); }
+		void nodeValue(const std::string& val) override {}
+		void nodeValue(std::string&& val) override {}
+		string_view nodeNameView() const override { return tape().view(rec().name); }
+		string_view nodeValueView() const override { return tape().view(rec().value); }
+		NODE_TYPE nodeType() const override { return rec().type; }
+
+		NodePtr parentNode() override { return m_doc->parent(m_index); }
+		NodeListPtr childNodes() override { return m_doc->children(m_index); }
+		NodePtr firstChild() override
+		{
+			size_t child = tape().firstChild(m_index);
+			if (child >= rec().end)
+				return nullptr;
+			return m_doc->node(child);
+		}
+		NodePtr lastChild() override
+		{
+			auto& records = tape().records;
+			size_t end = rec().end;
+			size_t last = end;
+			for (size_t child = tape().firstChild(m_index); child < end; child = records[child].end)
+				last = child;
+			if (last == end)
+				return nullptr;
+			return m_doc->node(last);
+		}
+		NodePtr previousSibling() override { return m_doc->previous(m_index); }
+		NodePtr nextSibling() override { return m_doc->next(m_index); }
+
+		DocumentPtr ownerDocument() override { return m_doc->shared_from_this(); }
+		bool insertBefore(const NodePtr& child, const NodePtr& before = nullptr) override { return false; }
+		bool insertBefore(const NodeListPtr& children, const NodePtr& before = nullptr) override { return false; }
+		bool appendChild(const NodePtr& newChild) override { return false; }
+		bool replaceChild(const NodePtr& newChild, const NodePtr& oldChild) override { return false; }
+		bool replaceChild(const NodeListPtr& newChildren, const NodePtr& oldChild) override { return false; }
+		bool removeChild(const NodePtr& child) override { return false; }
+
+		void* internalData() override { return nullptr; }
+
+		NodePtr find(const std::string& path, const Namespaces& ns) override
+		{
+			return m_doc->find(xpath::XPath(path, ns), m_index);
+		}
+		NodeListPtr findall(const std::string& path, const Namespaces& ns) override
+		{
+			return m_doc->findall(xpath::XPath(path, ns), m_index);
+		}
+	};
+
+	template <typename Interface>
+	class ChildNodeBase : public NodeBase<Interface>
+	{
+	public:
+		ChildNodeBase(Document* doc, size_t index) : NodeBase<Interface>(doc, index) {}
+
+		bool before(const NodePtr& node) override { return false; }
+		bool before(const std::string& data) override { return false; }
+		bool before(const NodeListPtr& nodes) override { return false; }
+		bool after(const NodePtr& node) override { return false; }
+		bool after(const std::string& data) override { return false; }
+		bool after(const NodeListPtr& nodes) override { return false; }
+		bool replace(const NodePtr& node) override { return false; }
+		bool replace(const std::string& data) override { return false; }
+		bool replace(const NodeListPtr& nodes) override { return false; }
+		bool remove() override { return false; }
+	};
+
+	template <typename Interface>
+	class ParentNodeBase : public ChildNodeBase<Interface>
+	{
+	public:
+		ParentNodeBase(Document* doc, size_t index) : ChildNodeBase<Interface>(doc, index) {}
+
+		bool prepend(const NodePtr& node) override { return false; }
+		bool prepend(const NodeListPtr& nodes) override { return false; }
+		bool prepend(const std::string& data) override { return false; }
+		bool append(const NodePtr& node) override { return false; }
+		bool append(const NodeListPtr& nodes) override { return false; }
+		bool append(const std::string& data) override { return false; }
+	};
+
+	class Element : public ParentNodeBase<dom::Element>
+	{
+		size_t findAttribute(const std::string& name) const
+		{
+			auto& tape = this->tape();
+			size_t end = tape.firstChild(m_index);
+			for (size_t i = m_index + 1; i < end; ++i)
+			{
+				if (tape.equals(tape.records[i].name, name))
+					return i;
+			}
+			return 0;
+		}
+	public:
+		Element(Document* doc, size_t index) : ParentNodeBase(doc, index) {}
+
+		std::string getAttribute(const std::string& name) override
+		{
+			size_t attr = findAttribute(name);
+			if (!attr)
+				return std::string();
+			return tape().str(tape().records[attr].value);
+		}
+		string_view getAttributeView(const std::string& name) override
+		{
+			size_t attr = findAttribute(name);
+			if (!attr)
+				return string_view();
+			return tape().view(tape().records[attr].value);
+		}
+		dom::AttributePtr getAttributeNode(const std::string& name) override
+		{
+			size_t attr = findAttribute(name);
+			if (!attr)
+				return nullptr;
+			return std::static_pointer_cast<dom::Attribute>(m_doc->node(attr));
+		}
+		bool setAttribute(const dom::AttributePtr& attr) override { return false; }
+		bool removeAttribute(const AttributePtr& attr) override { return false; }
+		bool setAttribute(const std::string& attr, const std::string& value) override { return false; }
+		bool setAttribute(std::string&& attr, std::string&& value) override { return false; }
+		bool removeAttribute(const std::string& attr) override { return false; }
+		dom::NodeListPtr getAttributes() override
+		{
+			size_t end = tape().firstChild(m_index);
+			std::vector<NodePtr> out;
+			out.reserve(end - m_index - 1);
+			for (size_t i = m_index + 1; i < end; ++i)
+				out.push_back(m_doc->node(i));
+			return createList(out);
+		}
+		void visitAttributes(AttributeVisitor& visitor) override
+		{
+			size_t end = tape().firstChild(m_index);
+			for (size_t i = m_index + 1; i < end; ++i)
+			{
+				auto& attr = tape().records[i];
+				visitor.onAttribute(tape().view(attr.name), tape().view(attr.value));
+			}
+		}
+		bool hasAttribute(const std::string& name) override { return findAttribute(name) != 0; }
+		dom::NodeListPtr getElementsByTagName(const std::string& tagName) override
+		{
+			std::vector<NodePtr> out;
+			m_doc->enumTagNames(m_index, rec().end, tagName, out);
+			return createList(out);
+		}
+		std::string innerText() override
+		{
+			std::string out;
+			tape().innerText(m_index, out);
+			return out;
+		}
+	};
+
+	class Text : public ChildNodeBase<dom::Text>
+	{
+	public:
+		Text(Document* doc, size_t index) : ChildNodeBase(doc, index) {}
+	};
+
+	class Attribute : public NodeBase<dom::Attribute>
+	{
+	public:
+		Attribute(Document* doc, size_t index) : NodeBase(doc, index) {}
+	};
+
+	dom::Node* Document::createHandle(size_t index)
+	{
+		try
+		{
+			switch (m_tape.records[index].type)
+			{
+			case ELEMENT_NODE:
+				return new Element(this, index);
+			case TEXT_NODE:
+				return new Text(this, index);
+			case ATTRIBUTE_NODE:
+				return new Attribute(this, index);
+			default:
+				break;
+			}
+		}
+		catch (std::bad_alloc) {}
+		return nullptr;
+	}
+
+	NodePtr Document::node(size_t index)
+	{
+		if (index >= m_tape.records.size())
+			return nullptr;
+
+		if (m_tape.records[index].type == DOCUMENT_NODE)
+			return shared_from_this();
+
+		auto& slot = m_handles[index];
+		dom::Node* handle = slot.load(std::memory_order_acquire);
+		if (!handle)
+		{
+			handle = createHandle(index);
+			if (!handle)
+				return nullptr;
+
+			// two readers may race here; both end up with the first one stored
+			dom::Node* expected = nullptr;
+			if (!slot.compare_exchange_strong(expected, handle, std::memory_order_acq_rel))
+			{
+				delete handle;
+				handle = expected;
+			}
+		}
+
+		return NodePtr(shared_from_this(), handle);
+	}
+
+	// XPath over the records, with no node objects until the results are
+	// known. It takes the same steps, in the same order, as the generic
+	// evaluator in dom_xpath.cpp, so both documents give the same answers.
+	class Evaluator
+	{
+		const Tape& m_tape;
+		std::vector<size_t> m_local;          // one segment from one context
+		std::vector<size_t> m_steps, m_next;  // the predicate's own path
+		std::string m_text;
+
+		static bool like(const QName& name, const QName& tmplt)
+		{
+			if (tmplt.nsName.empty() && tmplt.localName.empty())
+				return true;
+			if (tmplt.nsName != "*" && tmplt.nsName != name.nsName)
+				return false;
+			if (tmplt.localName != "*" && tmplt.localName != name.localName)
+				return false;
+			return true;
+		}
+
+		bool passable(const xpath::SimpleSelector& sel, size_t& index) const
+		{
+			auto& rec = m_tape.records[index];
+			switch (sel.m_test)
+			{
+			case xpath::TEST_NODE: return true;
+			case xpath::TEST_TEXT: return rec.type == TEXT_NODE;
+			case xpath::TEST_DOCUMENT_NODE:
+				index = 0;
+				return true;
+			case xpath::TEST_ELEMENT:
+				return rec.type == ELEMENT_NODE && like(m_tape.qnames[rec.qname], sel.m_name);
+			case xpath::TEST_ATTRIBUTE:
+				return rec.type == ATTRIBUTE_NODE && like(m_tape.qnames[rec.qname], sel.m_name);
+			}
+			return false;
+		}
+
+		void test(const xpath::SimpleSelector& sel, size_t index, std::vector<size_t>& out) const
+		{
+			if (passable(sel, index))
+				out.push_back(index);
+		}
+
+		size_t parent(size_t index) const
+		{
+			return index ? m_tape.records[index].parent : 0; // 0 for none
+		}
+
+		void children(const xpath::SimpleSelector& sel, size_t index, std::vector<size_t>& out) const
+		{
+			auto& records = m_tape.records;
+			size_t end = records[index].end;
+			for (size_t child = m_tape.firstChild(index); child < end; child = records[child].end)
+				test(sel, child, out);
+		}
+
+		void attributes(const xpath::SimpleSelector& sel, size_t index, std::vector<size_t>& out) const
+		{
+			if (m_tape.records[index].type != ELEMENT_NODE)
+				return;
+			size_t end = m_tape.firstChild(index);
+			for (size_t attr = index + 1; attr < end; ++attr)
+				test(sel, attr, out);
+		}
+
+		void descendants(const xpath::SimpleSelector& sel, size_t index, std::vector<size_t>& out) const
+		{
+			auto& records = m_tape.records;
+			size_t end = records[index].end;
+			children(sel, index, out);
+			for (size_t child = m_tape.firstChild(index); child < end; child = records[child].end)
+				descendants(sel, child, out);
+		}
+
+		void ancestors(const xpath::SimpleSelector& sel, size_t index, std::vector<size_t>& out) const
+		{
+			for (size_t up = parent(index); up; up = parent(up))
+				test(sel, up, out);
+		}
+
+		void select(const xpath::SimpleSelector& sel, size_t context, std::vector<size_t>& out) const
+		{
+			switch (sel.m_axis)
+			{
+			case xpath::AXIS_CHILD:
+				attributes(sel, context, out);
+				children(sel, context, out);
+				return;
+			case xpath::AXIS_DESCENDANT:
+				descendants(sel, context, out);
+				return;
+			case xpath::AXIS_ATTRIBUTE:
+				attributes(sel, context, out);
+				return;
+			case xpath::AXIS_SELF:
+				test(sel, context, out);
+				return;
+			case xpath::AXIS_DESCENDANT_OR_SELF:
+				test(sel, context, out);
+				descendants(sel, context, out);
+				return;
+			case xpath::AXIS_PARENT:
+				if (parent(context))
+					test(sel, parent(context), out);
+				return;
+			case xpath::AXIS_ANCESTOR:
+				ancestors(sel, context, out);
+				return;
+			case xpath::AXIS_ANCESTOR_OR_SELF:
+				test(sel, context, out);
+				ancestors(sel, context, out);
+				return;
+			}
+		}
+
+		bool equals(size_t index, const std::string& value)
+		{
+			auto& rec = m_tape.records[index];
+			switch (rec.type)
+			{
+			case ELEMENT_NODE:
+				m_text.clear();
+				m_tape.innerText(index, m_text);
+				return m_text == value;
+			case TEXT_NODE:
+			case ATTRIBUTE_NODE:
+				return m_tape.equals(rec.value, value);
+			default:
+				return value.empty();
+			}
+		}
+
+		bool test(const xpath::Predicate& pred, size_t context)
+		{
+			m_steps.clear();
+			m_steps.push_back(context);
+			for (auto&& sel : pred.m_selectors)
+			{
+				m_next.clear();
+				for (auto index : m_steps)
+					select(sel, index, m_next);
+				m_steps.swap(m_next);
+			}
+
+			if (pred.m_type == xpath::PRED_EXISTS)
+				return !m_steps.empty();
+
+			for (auto index : m_steps)
+			{
+				if (equals(index, pred.m_value))
+					return true;
+			}
+			return false;
+		}
+
+	public:
+		explicit Evaluator(const Tape& tape) : m_tape(tape) {}
+
+		void select(const xpath::XPath& xpath, size_t context, std::vector<size_t>& out)
+		{
+			std::vector<size_t> list;
+			out.assign(1, context);
+			for (auto&& seg : xpath.m_segments)
+			{
+				list.clear();
+				for (auto ctx : out)
+				{
+					m_local.clear();
+					select(seg.m_selector, ctx, m_local);
+					for (auto index : m_local)
+					{
+						bool accepted = true;
+						for (auto&& pred : seg.m_preds)
+						{
+							if (!test(pred, index))
+							{
+								accepted = false;
+								break;
+							}
+						}
+						if (accepted)
+							list.push_back(index);
+					}
+				}
+				out.swap(list);
+			}
+		}
+	};
+
+	NodePtr Document::find(const xpath::XPath& xpath, size_t context)
+	{
+		LIBWEB_ALLOC_SCOPE("XPath::find");
+		try
+		{
+			std::vector<size_t> found;
+			Evaluator(m_tape).select(xpath, context, found);
+			if (found.empty())
+				return nullptr;
+			return node(found.front());
+		}
+		catch (std::bad_alloc) {}
+		return nullptr;
+	}
+
+	NodeListPtr Document::findall(const xpath::XPath& xpath, size_t context)
+	{
+		LIBWEB_ALLOC_SCOPE("XPath::findall");
+		try
+		{
+			std::vector<size_t> found;
+			Evaluator(m_tape).select(xpath, context, found);
+			if (found.empty())
+				return nullptr;
+
+			std::vector<NodePtr> out;
+			out.reserve(found.size());
+			for (auto index : found)
+				out.push_back(node(index));
+			return createList(out);
+		}
+		catch (std::bad_alloc) {}
+		return nullptr;
+	}
+
+	NodeListPtr Document::children(size_t index)
+	{
+		auto& records = m_tape.records;
+		size_t end = records[index].end;
+
+		std::vector<NodePtr> out;
+		for (size_t child = m_tape.firstChild(index); child < end; child = records[child].end)
+			out.push_back(node(child));
+		return createList(out);
+	}
+
+	NodePtr Document::parent(size_t index)
+	{
+		// the top-level nodes are not attached to the document, same as
+		// the document element of the mutable document
+		size_t parent = m_tape.records[index].parent;
+		if (!parent)
+			return nullptr;
+		return node(parent);
+	}
+
+	NodePtr Document::previous(size_t index)
+	{
+		auto& records = m_tape.records;
+		if (!index || records[index].type == ATTRIBUTE_NODE)
+			return nullptr;
+
+		size_t prev = index;
+		size_t parent = records[index].parent;
+		for (size_t child = m_tape.firstChild(parent); child < index; child = records[child].end)
+			prev = child;
+
+		if (prev == index)
+			return nullptr;
+		return node(prev);
+	}
+
+	NodePtr Document::next(size_t index)
+	{
+		auto& records = m_tape.records;
+		if (!index || records[index].type == ATTRIBUTE_NODE)
+			return nullptr;
+
+		size_t next = records[index].end;
+		if (next >= records[records[index].parent].end)
+			return nullptr;
+		return node(next);
+	}
+
+	void Document::enumTagNames(size_t from, size_t to, const std::string& tagName, std::vector<NodePtr>& out)
+	{
+		for (size_t i = from; i < to; ++i)
+		{
+			auto& rec = m_tape.records[i];
+			if (rec.type == ELEMENT_NODE && m_tape.equals(rec.name, tagName))
+				out.push_back(node(i));
+		}
+	}
+
+	NodePtr Document::firstChild()
+	{
+		if (m_tape.records.size() < 2)
+			return nullptr;
+		return node(1);
+	}
+
+	NodePtr Document::lastChild()
+	{
+		auto& records = m_tape.records;
+		size_t last = 0;
+		for (size_t child = 1; child < records.size(); child = records[child].end)
+			last = child;
+		if (!last)
+			return nullptr;
+		return node(last);
+	}
+
+	dom::ElementPtr Document::documentElement()
+	{
+		auto& records = m_tape.records;
+		if (records.size() < 2 || records[1].type != ELEMENT_NODE || records[1].end != records.size())
+			return nullptr;
+		return std::static_pointer_cast<dom::Element>(node(1));
+	}
+
+	dom::NodeListPtr Document::getElementsByTagName(const std::string& tagName)
+	{
+		std::vector<NodePtr> out;
+		enumTagNames(1, m_tape.records.size(), tagName, out);
+		return createList(out);
+	}
+
+	dom::NodeListPtr Document::getElementsByAttribute(const std::string& name, const std::string& value)
+	{
+		return getElementsByAttribute(name, value, shared_from_this());
+	}
+
+	dom::NodeListPtr Document::getElementsByAttribute(const std::string& name, const std::string& value, const NodePtr& scope)
+	{
+		auto& records = m_tape.records;
+		std::vector<NodePtr> out;
+
+		// a node of this document is the handle cached for its record
+		size_t scopeIndex = 0;
+		if (scope.get() != static_cast<dom::Node*>(this))
+		{
+			scopeIndex = records.size();
+			for (size_t i = 1; i < records.size(); ++i)
+			{
+				if (m_handles[i].load(std::memory_order_acquire) == scope.get())
+				{
+					scopeIndex = i;
+					break;
+				}
+			}
+			if (scopeIndex == records.size())
+				return createList(out);
+		}
+
+		size_t end = scopeIndex ? records[scopeIndex].end : records.size();
+		for (size_t i = scopeIndex + 1; i < end; ++i)
+		{
+			auto& rec = records[i];
+			if (rec.type != ATTRIBUTE_NODE || rec.parent == scopeIndex)
+				continue;
+			if (m_tape.equals(rec.name, name) && m_tape.equals(rec.value, value))
+				out.push_back(node(rec.parent));
+		}
+		return createList(out);
+	}
+
+	NodePtr Document::find(const std::string& path, const Namespaces& ns)
+	{
+		return find(xpath::XPath(path, ns), 0);
+	}
+
+	NodeListPtr Document::findall(const std::string& path, const Namespaces& ns)
+	{
+		return findall(xpath::XPath(path, ns), 0);
+	}
+
+	Builder::Builder()
+		: m_startTag(false)
+	{
+		intern(std::string(), std::string());
+
+		Record doc;
+		doc.type = DOCUMENT_NODE;
+		doc.parent = 0;
+		doc.end = 1;
+		doc.attrs = 0;
+		doc.qname = intern(std::string(), "#document");
+		doc.name = doc.value = store(nullptr, 0);
+		m_tape.records.push_back(doc);
+		m_stack.push_back(0);
+	}
+
+	Slice Builder::store(const char* data, size_t length)
+	{
+		Slice slice = { m_tape.strings.length(), length };
+		if (length)
+			m_tape.strings.append(data, length);
+		return slice;
+	}
+
+	size_t Builder::push(NODE_TYPE type, const char* name, size_t nameLength, const char* value, size_t valueLength)
+	{
+		size_t index = m_tape.records.size();
+
+		Record rec;
+		rec.type = type;
+		rec.parent = m_stack.back();
+		rec.end = index + 1;
+		rec.attrs = 0;
+		rec.qname = 0;
+		rec.name = store(name, nameLength);
+		rec.value = store(value, valueLength);
+		m_tape.records.push_back(rec);
+
+		return index;
+	}
+
+	size_t Builder::intern(const std::string& nsName, const std::string& localName)
+	{
+		std::string key = nsName;
+		key.push_back(0);
+		key.append(localName);
+
+		auto it = m_qnames.find(key);
+		if (it != m_qnames.end())
+			return it->second;
+
+		size_t index = m_tape.qnames.size();
+		QName qname;
+		qname.nsName = nsName;
+		qname.localName = localName;
+		m_tape.qnames.push_back(qname);
+		m_qnames[key] = index;
+		return index;
+	}
+
+	const std::string* Builder::lookup(const std::string& prefix) const
+	{
+		for (auto it = m_bindings.rbegin(); it != m_bindings.rend(); ++it)
+		{
+			if (it->prefix == prefix)
+				return &it->uri;
+		}
+		return nullptr;
+	}
+
+	void Builder::resolve(Record& rec, bool forElem)
+	{
+		std::string name = m_tape.str(rec.name);
+		std::string::size_type col = name.find(':');
+		if (col == std::string::npos && !forElem)
+		{
+			rec.qname = intern(std::string(), name);
+			return;
+		}
+
+		const std::string* uri = nullptr;
+		if (col == std::string::npos)
+			uri = lookup(std::string());
+		else
+			uri = lookup(name.substr(0, col));
+
+		if (!uri)
+			rec.qname = intern(std::string(), name);
+		else if (col == std::string::npos)
+			rec.qname = intern(*uri, name);
+		else
+			rec.qname = intern(*uri, name.substr(col + 1));
+	}
+
+	void Builder::closeStartTag()
+	{
+		if (!m_startTag)
+			return;
+		m_startTag = false;
+
+		size_t elem = m_stack.back();
+		size_t end = m_tape.firstChild(elem);
+
+		m_scopes.push_back(m_bindings.size());
+		for (size_t i = elem + 1; i < end; ++i)
+		{
+			auto& rec = m_tape.records[i];
+			const char* name = m_tape.strings.c_str() + rec.name.offset;
+			if (rec.name.length < 5 || strncmp(name, "xmlns", 5) != 0)
+				continue;
+			if (rec.name.length != 5 && name[5] != ':')
+				continue;
+
+			Binding binding;
+			if (rec.name.length > 6)
+				binding.prefix.assign(name + 6, rec.name.length - 6);
+			binding.uri = m_tape.str(rec.value);
+			m_bindings.push_back(binding);
+			rec.qname = intern(std::string(), m_tape.str(rec.name));
+		}
+
+		resolve(m_tape.records[elem], true);
+		for (size_t i = elem + 1; i < end; ++i)
+		{
+			auto& rec = m_tape.records[i];
+			if (!rec.qname)
+				resolve(rec, false);
+		}
+	}
+
+	void Builder::startElement(const char* name)
+	{
+		closeStartTag();
+		size_t index = push(ELEMENT_NODE, name, strlen(name), nullptr, 0);
+		m_stack.push_back(index);
+		m_startTag = true;
+	}
+
+	void Builder::attribute(const char* name, const char* value)
+	{
+		if (!m_startTag)
+			return;
+		push(ATTRIBUTE_NODE, name, strlen(name), value, strlen(value));
+		++m_tape.records[m_stack.back()].attrs;
+	}
+
+	void Builder::text(const char* data, size_t length)
+	{
+		closeStartTag();
+		push(TEXT_NODE, nullptr, 0, data, length);
+	}
+
+	void Builder::endElement()
+	{
+		closeStartTag();
+		if (!depth())
+			return;
+
+		size_t index = m_stack.back();
+		m_stack.pop_back();
+		m_tape.records[index].end = m_tape.records.size();
+
+		m_bindings.resize(m_scopes.back());
+		m_scopes.pop_back();
+	}
+
+	DocumentPtr Builder::finish()
+	{
+		while (depth())
+			endElement();
+		closeStartTag();
+
+		m_tape.records[0].end = m_tape.records.size();
+		try
+		{
+			return std::make_shared<Document>(std::move(m_tape));
+		}
+		catch (std::bad_alloc) { return nullptr; }
+	}
+}}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __DOM_INTERNAL_TAPE_HPP__
+#define __DOM_INTERNAL_TAPE_HPP__
+
+#include <dom/dom.hpp>
+#include <dom/dom_xpath.hpp>
+#include <vector>
+#include <map>
+
+namespace dom { namespace tape {
+
+	// Read-only document representation: the whole tree is kept in
+	// a single vector of records in document order, with all names
+	// and values stored as slices of one string buffer. An element
+	// record is followed by its attribute records and then by its
+	// descendants; "end" points one past the last record of the
+	// subtree, so the next sibling of a record is at its "end".
+
+	struct Slice
+	{
+		size_t offset;
+		size_t length;
+	};
+
+	struct Record
+	{
+		NODE_TYPE type;
+		size_t parent;
+		size_t end;
+		size_t attrs;
+		size_t qname;
+		Slice name;
+		Slice value;
+	};
+
+	struct Tape
+	{
+		std::vector<Record> records;
+		std::vector<QName> qnames;
+		std::string strings;
+
+		std::string str(const Slice& slice) const { return std::string(strings.c_str() + slice.offset, slice.length); }
+		string_view view(const Slice& slice) const { return string_view(strings.c_str() + slice.offset, slice.length); }
+		bool equals(const Slice& slice, const std::string& s) const
+		{
+			return slice.length == s.length() && !s.compare(0, s.length(), strings.c_str() + slice.offset, slice.length);
+		}
+		size_t firstChild(size_t index) const { return index + 1 + records[index].attrs; }
+		void innerText(size_t index, std::string& out) const;
+	};
+
+	class Builder
+	{
+		struct Binding
+		{
+			std::string prefix;
+			std::string uri;
+		};
+
+		Tape m_tape;
+		std::vector<size_t> m_stack;
+		std::vector<Binding> m_bindings;
+		std::vector<size_t> m_scopes;
+		std::map<std::string, size_t> m_qnames;
+		bool m_startTag;
+
+		Slice store(const char* data, size_t length);
+		size_t push(NODE_TYPE type, const char* name, size_t nameLength, const char* value, size_t valueLength);
+		size_t intern(const std::string& nsName, const std::string& localName);
+		const std::string* lookup(const std::string& prefix) const;
+		void resolve(Record& rec, bool forElem);
+		void closeStartTag();
+	public:
+		Builder();
+
+		size_t depth() const { return m_stack.size() - 1; }
+		void startElement(const char* name);
+		void attribute(const char* name, const char* value);
+		void text(const char* data, size_t length);
+		void endElement();
+		DocumentPtr finish();
+	};
+}}
+
+#endif // __DOM_INTERNAL_TAPE_HPP__
@@ -46,6 +46,7 @@
 #include <string>
 #include <http/http.hpp>
 #include <utils.hpp>
+#include <libweb/alloc_scope.hpp>
 #include <mt.hpp>
 
 namespace std
@@ -522,6 +523,7 @@ namespace http
 
 	Curl::size_type Curl::onData(const char* data, size_type length)
 	{
+		LIBWEB_ALLOC_SCOPE("http::onData");
 		// Redirects should not have bodies anyway
 		// And if we redirect, there will be a new header soon...
 		if (isRedirect()) return length;
@@ -537,6 +539,7 @@ namespace http
 
 	Curl::size_type Curl::onHeader(const char* data, size_type length)
 	{
+		LIBWEB_ALLOC_SCOPE("http::onHeader");
 		size_t read = 0;
 
 		bool rn_present = false;
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include <libweb/alloc_scope.hpp>
+
+#ifdef LIBWEB_TRACK_ALLOCATIONS
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+
+namespace libweb
+{
+	namespace
+	{
+		thread_local alloc_scope* current = nullptr;
+		thread_local bool bookkeeping = false; // the registry's own allocations are not counted
+
+		struct Totals
+		{
+			size_t scopes;
+			size_t count;
+			size_t bytes;
+			size_t peak;
+			size_t overruns;
+		};
+
+		struct Budget
+		{
+			size_t count;
+			size_t bytes;
+		};
+
+		std::mutex& registryLock()
+		{
+			static std::mutex lock;
+			return lock;
+		}
+
+		std::map<std::string, Totals>& registry()
+		{
+			static std::map<std::string, Totals> totals;
+			return totals;
+		}
+
+		std::map<std::string, Budget>& budgets()
+		{
+			static std::map<std::string, Budget> budgets;
+			return budgets;
+		}
+
+		alloc_overrun_handler overrunHandler = nullptr;
+	}
+
+	alloc_scope::alloc_scope(const char* tag)
+		: m_tag(tag)
+		, m_outer(current)
+		, m_count(0)
+		, m_bytes(0)
+	{
+		current = this;
+	}
+
+	alloc_scope::~alloc_scope()
+	{
+		current = m_outer;
+		if (m_outer)
+		{
+			m_outer->m_count += m_count;
+			m_outer->m_bytes += m_bytes;
+		}
+
+		if (!m_tag)
+			return;
+
+		bookkeeping = true;
+		alloc_overrun_handler handler = nullptr;
+		try
+		{
+			std::lock_guard<std::mutex> guard(registryLock());
+			auto& totals = registry()[m_tag];
+			totals.scopes++;
+			totals.count += m_count;
+			totals.bytes += m_bytes;
+			if (totals.peak < m_count)
+				totals.peak = m_count;
+
+			auto it = budgets().find(m_tag);
+			if (it != budgets().end() && (m_count > it->second.count || m_bytes > it->second.bytes))
+			{
+				totals.overruns++;
+				handler = overrunHandler;
+			}
+		}
+		catch (std::bad_alloc&)
+		{
+		}
+
+		// outside of the lock, the handler may well read the totals
+		if (handler)
+			handler(m_tag, m_count, m_bytes);
+		bookkeeping = false;
+	}
+
+	void alloc_record(size_t size)
+	{
+		auto scope = current;
+		if (!scope || bookkeeping)
+			return;
+		scope->m_count++;
+		scope->m_bytes += size;
+	}
+
+	std::vector<alloc_report> alloc_totals()
+	{
+		std::vector<alloc_report> out;
+		std::lock_guard<std::mutex> guard(registryLock());
+		for (auto&& pair : registry())
+		{
+			alloc_report report = { pair.first, pair.second.scopes, pair.second.count, pair.second.bytes, pair.second.peak, pair.second.overruns };
+			out.push_back(std::move(report));
+		}
+		return out;
+	}
+
+	void alloc_reset_totals()
+	{
+		std::lock_guard<std::mutex> guard(registryLock());
+		registry().clear();
+	}
+
+	void alloc_set_budget(const char* tag, size_t count, size_t bytes)
+	{
+		std::lock_guard<std::mutex> guard(registryLock());
+		Budget budget = { count, bytes };
+		budgets()[tag] = budget;
+	}
+
+	void alloc_clear_budgets()
+	{
+		std::lock_guard<std::mutex> guard(registryLock());
+		budgets().clear();
+	}
+
+	alloc_overrun_handler alloc_on_overrun(alloc_overrun_handler handler)
+	{
+		std::lock_guard<std::mutex> guard(registryLock());
+		auto previous = overrunHandler;
+		overrunHandler = handler;
+		return previous;
+	}
+}
+
+void* operator new(size_t size)
+{
+	libweb::alloc_record(size);
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	libweb::alloc_record(size);
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+#else // !LIBWEB_TRACK_ALLOCATIONS
+
+namespace libweb
+{
+	std::vector<alloc_report> alloc_totals() { return std::vector<alloc_report>(); }
+	void alloc_reset_totals() {}
+	void alloc_set_budget(const char*, size_t, size_t) {}
+	void alloc_clear_budgets() {}
+	alloc_overrun_handler alloc_on_overrun(alloc_overrun_handler) { return nullptr; }
+}
+
+#endif
@@ -26,6 +26,7 @@
 #include <sstream>
 #include <wiki/wiki.hpp>
 #include <filesystem.hpp>
+#include <libweb/alloc_scope.hpp>
 #include "wiki_parser.hpp"
 #include "wiki_nodes.hpp"
 #include <iomanip>
@@ -164,12 +165,14 @@ namespace wiki
 		Document(const Nodes& children) : m_children(children) {}
 		void text(stream& o, const variables_t& vars, list_ctx& ctx) const override
 		{
+			LIBWEB_ALLOC_SCOPE("wiki::text");
 			for (auto& child : m_children)
 				child->text(o, vars, ctx);
 		}
 
 		void markup(stream& o, const variables_t& vars, const styler_ptr& styler, list_ctx& ctx) const override
 		{
+			LIBWEB_ALLOC_SCOPE("wiki::markup");
 			styler->begin_document(o);
 			for (auto& child : m_children)
 				child->markup(o, vars, styler, ctx);
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/parsers/feed.hpp>
+#include <dom/parsers/html.hpp>
+#include <map> // for the http.hpp
+#include <http/http.hpp>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// The budgets need the library's allocation tracking; without it, the
+// scopes count nothing and there is nothing to check.
+#ifdef LIBWEB_TRACK_ALLOCATIONS
+
+namespace
+{
+	size_t overruns = 0;
+	std::string lastTag;
+
+	void onOverrun(const char* tag, size_t, size_t)
+	{
+		++overruns;
+		lastTag = tag;
+	}
+
+	// Installs the budget for the duration of one test
+	struct Budget
+	{
+		libweb::alloc_overrun_handler previous;
+		Budget(const char* tag, size_t count, size_t bytes = (size_t)-1)
+		{
+			overruns = 0;
+			lastTag.clear();
+			libweb::alloc_set_budget(tag, count, bytes);
+			previous = libweb::alloc_on_overrun(onOverrun);
+		}
+		~Budget()
+		{
+			libweb::alloc_on_overrun(previous);
+			libweb::alloc_clear_budgets();
+		}
+	};
+
+	std::string rss(size_t items)
+	{
+		std::string out =
+			"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+			"<rss version=\"2.0\"><channel><title>Blog</title><link>http://example.com/</link>";
+		for (size_t i = 0; i < items; ++i)
+		{
+			auto id = std::to_string(i);
+			out += "<item><title>Item " + id + "</title>"
+				"<link>http://example.com/" + id + "</link>"
+				"<guid>urn:item:" + id + "</guid>"
+				"<pubDate>Mon, 01 Jul 2013 00:00:00 +0200</pubDate>"
+				"<category>c</category>"
+				"<description>&lt;p&gt;Some text of the item number " + id + "&lt;/p&gt;</description>"
+				"</item>";
+		}
+		out += "</channel></rss>";
+		return out;
+	}
+
+	bool parseFeed(const std::string& text, size_t& items)
+	{
+		dom::parsers::feed::Feed feed;
+		bool ret = dom::parsers::feed::parse(std::string(), text.data(), text.size(), feed);
+		items = feed.items.size();
+		return ret;
+	}
+}
+
+// The budgets below are about twice the counts of the current code; they
+// are there to catch a change, which makes a path allocate per byte or per
+// event instead of per field.
+
+TEST(alloc_budget_overrun)
+{
+	// a threshold nothing can meet must fail
+	auto text = rss(1);
+	Budget budget("feed::parse", 1);
+	size_t items = 0;
+	CHECK(parseFeed(text, items));
+	CHECK_EQ(overruns, 1u);
+	CHECK_EQ(lastTag, std::string("feed::parse"));
+
+	for (auto&& report : libweb::alloc_totals())
+	{
+		if (report.tag == "feed::parse")
+			CHECK(report.overruns > 0);
+	}
+}
+
+TEST(alloc_budget_feed)
+{
+	// the fields longer than the short string buffer, the categories and
+	// the items' vector: about five allocations per item
+	static const size_t ITEMS = 200;
+	auto text = rss(ITEMS);
+	Budget budget("feed::parse", 64 + 10 * ITEMS);
+	size_t items = 0;
+	CHECK(parseFeed(text, items));
+	CHECK_EQ(items, ITEMS);
+	CHECK_EQ(overruns, 0u);
+}
+
+TEST(alloc_budget_extract_text)
+{
+	// Gumbo allocates with malloc, so this counts the decoding and the
+	// text; the text is capped by the limit, however long the document
+	std::string html = "<html><body>";
+	for (size_t i = 0; i < 2000; ++i)
+		html += "<p>Paragraph <b>" + std::to_string(i) + "</b> of the document.</p>";
+	html += "</body></html>";
+
+	Budget budget("html::extractText", 32, 16 * 1024);
+	auto text = dom::parsers::html::extractText("utf-8", html.data(), html.size(), 1024);
+	CHECK(text.length() <= 1024);
+	CHECK_EQ(overruns, 0u);
+}
+
+#ifndef _WIN32
+TEST(alloc_budget_http)
+{
+	// The body is read through curl's file:// handler. Each chunk is
+	// appended to the response, which grows at most once per chunk.
+	std::string path = "alloc_budget_http.txt";
+	std::string body(256 * 1024, 'x');
+	FILE* f = fopen(path.c_str(), "wb");
+	CHECK(!!f);
+	if (!f)
+		return;
+	fwrite(body.data(), 1, body.size(), f);
+	fclose(f);
+
+	char cwd[4096];
+	CHECK(!!getcwd(cwd, sizeof(cwd)));
+
+	{
+		Budget budget("http::onData", 1);
+		auto xhr = http::XmlHttpRequest::Create();
+		xhr->open(http::HTTP_GET, std::string("file://") + cwd + "/" + path, false);
+		xhr->send();
+		CHECK_EQ(xhr->getResponseTextLength(), body.size());
+		CHECK_EQ(overruns, 0u);
+	}
+
+	remove(path.c_str());
+}
+#endif
+
+#endif // LIBWEB_TRACK_ALLOCATIONS
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/parsers/html.hpp>
+
+using namespace dom::parsers;
+
+namespace
+{
+	std::string extract(const std::string& html, size_t limit = 0)
+	{
+		return html::extractText("utf-8", html.data(), html.size(), limit);
+	}
+
+	size_t codePoints(const std::string& text)
+	{
+		size_t count = 0;
+		for (auto c : text)
+		{
+			if (((unsigned char)c & 0xC0) != 0x80)
+				++count;
+		}
+		return count;
+	}
+}
+
+TEST(extract_text_blocks)
+{
+	CHECK_EQ(extract("<p>one  two</p><p>three</p>"), std::string("one two\n\nthree"));
+	CHECK_EQ(extract("<div>a</div><div>b</div>x<br>y"), std::string("a\nb\nx\ny"));
+	CHECK_EQ(extract("<table><tr><td>1</td><td>2</td></tr></table>"), std::string("1 2"));
+	CHECK_EQ(extract("<script>var x;</script><p hidden>no</p><span style=\"display: none\">no</span>yes"), std::string("yes"));
+	CHECK_EQ(extract("<pre>a\n  b</pre>"), std::string("a\n  b"));
+}
+
+TEST(extract_text_limit)
+{
+	// the breaks between the blocks count, too
+	CHECK_EQ(extract("<p>ab</p><p>cd</p>", 2), std::string("ab"));
+	CHECK_EQ(extract("<p>ab</p><p>cd</p>", 4), std::string("ab"));
+	CHECK_EQ(extract("<p>ab</p><p>cd</p>", 5), std::string("ab\n\nc"));
+	CHECK_EQ(extract("<b>ab</b> <b>cd</b>", 3), std::string("ab"));
+	CHECK_EQ(extract("<p>\xC4\x85\xC4\x87</p>", 1), std::string("\xC4\x85"));
+}
+
+TEST(extract_text_window)
+{
+	// far more markup than the window, which the limit asks for; the cut
+	// text must be the start of the text of the whole document
+	std::string html = "<html><body>";
+	for (size_t i = 0; i < 20000; ++i)
+		html += "<div class=\"row\"><a href=\"#" + std::to_string(i) + "\" title=\"a&lt;b\">&amp;" + std::to_string(i) + "</a><!-- <p> --></div>";
+	html += "</body></html>";
+
+	auto full = extract(html);
+	for (size_t limit : { 1u, 100u, 5000u, 60000u, 200000u })
+	{
+		auto text = extract(html, limit);
+		CHECK(codePoints(text) <= limit);
+		CHECK_EQ(text, full.substr(0, text.length()));
+		// short of the limit only by a separator, which did not fit
+		if (limit < codePoints(full))
+			CHECK(codePoints(text) + 2 >= limit);
+	}
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/parsers/feed.hpp>
+#include <cstdio>
+#include <cstring>
+
+using namespace dom::parsers;
+
+namespace
+{
+	bool parse(const char* text, feed::Feed& out)
+	{
+		return feed::parse(std::string(), text, strlen(text), out);
+	}
+
+	const char* rss2 =
+		"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+		"<rss version=\"2.0\" xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:content=\"http://purl.org/rss/1.0/modules/content/\">"
+		"<channel>"
+		"<title> Blog </title>"
+		"<link>http://example.com/</link>"
+		"<description>About things</description>"
+		"<language>en</language>"
+		"<lastBuildDate>Tue, 02 Jul 2013 10:00:00 GMT</lastBuildDate>"
+		"<item>"
+		"<title>First</title>"
+		"<link>http://example.com/1</link>"
+		"<guid isPermaLink=\"false\">urn:1</guid>"
+		"<pubDate>Mon, 01 Jul 2013 10:00:00 +0200</pubDate>"
+		"<dc:creator>Jane</dc:creator>"
+		"<category>a</category><category>b</category>"
+		"<description>&lt;p&gt;Hi&lt;/p&gt;</description>"
+		"<content:encoded><![CDATA[<p>Full</p>]]></content:encoded>"
+		"<enclosure url=\"http://example.com/1.mp3\" type=\"audio/mpeg\" length=\"1234\"/>"
+		"</item>"
+		"<item><title>Second</title></item>"
+		"</channel></rss>";
+
+	const char* rss1 =
+		"<?xml version=\"1.0\"?>\n"
+		"<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\" xmlns=\"http://purl.org/rss/1.0/\" xmlns:dc=\"http://purl.org/dc/elements/1.1/\">"
+		"<channel rdf:about=\"http://example.com/\">"
+		"<title>Old blog</title>"
+		"<link>http://example.com/</link>"
+		"<description>RDF</description>"
+		"<dc:date>2013-07-02T10:00:00Z</dc:date>"
+		"</channel>"
+		"<item rdf:about=\"http://example.com/1\">"
+		"<title>First</title>"
+		"<link>http://example.com/1</link>"
+		"<dc:date>2013-07-01T10:00:00+02:00</dc:date>"
+		"<dc:subject>a</dc:subject>"
+		"</item>"
+		"</rdf:RDF>";
+
+	const char* atom =
+		"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+		"<feed xmlns=\"http://www.w3.org/2005/Atom\">"
+		"<title>Atom blog</title>"
+		"<subtitle>Subtitle</subtitle>"
+		"<link rel=\"self\" href=\"http://example.com/feed\"/>"
+		"<link href=\"http://example.com/\"/>"
+		"<updated>2013-07-02T10:00:00Z</updated>"
+		"<entry>"
+		"<title>First</title>"
+		"<id>urn:1</id>"
+		"<link href=\"http://example.com/1\"/>"
+		"<link rel=\"enclosure\" href=\"http://example.com/1.ogg\" length=\"10\"/>"
+		"<published>2013-07-01T10:00:00+02:00</published>"
+		"<updated>2013-07-01T11:00:00+02:00</updated>"
+		"<author><name>Jane</name></author>"
+		"<category term=\"a\"/>"
+		"<summary>Short &amp; sweet</summary>"
+		"<content type=\"xhtml\"><div xmlns=\"http://www.w3.org/1999/xhtml\"><p class=\"x\">Full<br/>text</p></div></content>"
+		"</entry>"
+		"</feed>";
+
+	// 2013-07-01T08:00:00Z
+	const time_t JULY_1ST = 1372665600;
+}
+
+TEST(feed_rss2)
+{
+	feed::Feed out;
+	CHECK(parse(rss2, out));
+	CHECK_EQ(out.format, feed::RSS2);
+	CHECK_EQ(out.title, std::string("Blog"));
+	CHECK_EQ(out.link, std::string("http://example.com/"));
+	CHECK_EQ(out.description, std::string("About things"));
+	CHECK_EQ(out.language, std::string("en"));
+	CHECK_EQ(out.updated, JULY_1ST + 26 * 3600);
+	CHECK_EQ(out.items.size(), 2u);
+	if (out.items.size() != 2)
+		return;
+
+	auto& item = out.items[0];
+	CHECK_EQ(item.title, std::string("First"));
+	CHECK_EQ(item.link, std::string("http://example.com/1"));
+	CHECK_EQ(item.guid, std::string("urn:1"));
+	CHECK_EQ(item.author, std::string("Jane"));
+	CHECK_EQ(item.published, JULY_1ST);
+	CHECK_EQ(item.publishedText, std::string("Mon, 01 Jul 2013 10:00:00 +0200"));
+	CHECK_EQ(item.categories.size(), 2u);
+	CHECK_EQ(item.summary.text, std::string("<p>Hi</p>"));
+	CHECK_EQ(item.summary.type, feed::CONTENT_HTML);
+	CHECK_EQ(item.content.text, std::string("<p>Full</p>"));
+	CHECK_EQ(item.enclosures.size(), 1u);
+	if (!item.enclosures.empty())
+	{
+		CHECK_EQ(item.enclosures[0].url, std::string("http://example.com/1.mp3"));
+		CHECK_EQ(item.enclosures[0].length, 1234u);
+	}
+	CHECK_EQ(out.items[1].title, std::string("Second"));
+}
+
+TEST(feed_rss1)
+{
+	feed::Feed out;
+	CHECK(parse(rss1, out));
+	CHECK_EQ(out.format, feed::RSS1);
+	CHECK_EQ(out.title, std::string("Old blog"));
+	CHECK_EQ(out.description, std::string("RDF"));
+	CHECK_EQ(out.updated, JULY_1ST + 26 * 3600);
+	CHECK_EQ(out.items.size(), 1u);
+	if (out.items.empty())
+		return;
+
+	auto& item = out.items[0];
+	CHECK_EQ(item.guid, std::string("http://example.com/1"));
+	CHECK_EQ(item.title, std::string("First"));
+	CHECK_EQ(item.link, std::string("http://example.com/1"));
+	CHECK_EQ(item.published, JULY_1ST);
+	CHECK_EQ(item.categories.size(), 1u);
+}
+
+TEST(feed_atom)
+{
+	feed::Feed out;
+	CHECK(parse(atom, out));
+	CHECK_EQ(out.format, feed::ATOM);
+	CHECK_EQ(out.title, std::string("Atom blog"));
+	CHECK_EQ(out.description, std::string("Subtitle"));
+	CHECK_EQ(out.link, std::string("http://example.com/"));
+	CHECK_EQ(out.links.size(), 2u);
+	CHECK_EQ(out.updated, JULY_1ST + 26 * 3600);
+	CHECK_EQ(out.items.size(), 1u);
+	if (out.items.empty())
+		return;
+
+	auto& item = out.items[0];
+	CHECK_EQ(item.title, std::string("First"));
+	CHECK_EQ(item.guid, std::string("urn:1"));
+	CHECK_EQ(item.link, std::string("http://example.com/1"));
+	CHECK_EQ(item.enclosures.size(), 1u);
+	CHECK_EQ(item.author, std::string("Jane"));
+	CHECK_EQ(item.published, JULY_1ST);
+	CHECK_EQ(item.updated, JULY_1ST + 3600);
+	CHECK_EQ(item.categories.size(), 1u);
+	CHECK_EQ(item.summary.text, std::string("Short & sweet"));
+	CHECK_EQ(item.content.type, feed::CONTENT_XHTML);
+	CHECK_EQ(item.content.text, std::string("<p class=\"x\">Full<br/>text</p>"));
+}
+
+TEST(feed_unbound_prefix)
+{
+	// the dc and content prefixes are used, but never declared
+	const char* text =
+		"<rss version=\"2.0\"><channel><title>Blog</title>"
+		"<item><title>First</title><dc:creator>Jane</dc:creator>"
+		"<content:encoded>&lt;p&gt;Full&lt;/p&gt;</content:encoded>"
+		"<x:unknown>skipped</x:unknown></item>"
+		"</channel></rss>";
+
+	feed::Feed out;
+	CHECK(parse(text, out));
+	CHECK_EQ(out.format, feed::RSS2);
+	CHECK_EQ(out.title, std::string("Blog"));
+	CHECK_EQ(out.items.size(), 1u);
+	if (out.items.empty())
+		return;
+	CHECK_EQ(out.items[0].title, std::string("First"));
+	CHECK_EQ(out.items[0].author, std::string("Jane"));
+	CHECK_EQ(out.items[0].content.text, std::string("<p>Full</p>"));
+
+	// and an Atom feed with one of the prefixes declared
+	const char* atomText =
+		"<a:feed xmlns:a=\"http://www.w3.org/2005/Atom\"><a:title>T</a:title>"
+		"<a:entry><a:title>E</a:title><dc:subject>s</dc:subject></a:entry></a:feed>";
+	feed::Feed atomOut;
+	CHECK(parse(atomText, atomOut));
+	CHECK_EQ(atomOut.format, feed::ATOM);
+	CHECK_EQ(atomOut.title, std::string("T"));
+	CHECK_EQ(atomOut.items.size(), 1u);
+
+	// the default namespace and the declared prefixes still count
+	std::string rdf = rss1;
+	rdf.insert(rdf.find("</item>"), "<slash:comments>3</slash:comments>");
+	feed::Feed rdfOut;
+	CHECK(parse(rdf.c_str(), rdfOut));
+	CHECK_EQ(rdfOut.format, feed::RSS1);
+	CHECK_EQ(rdfOut.title, std::string("Old blog"));
+	CHECK_EQ(rdfOut.items.size(), 1u);
+	if (!rdfOut.items.empty())
+	{
+		CHECK_EQ(rdfOut.items[0].guid, std::string("http://example.com/1"));
+		CHECK_EQ(rdfOut.items[0].published, JULY_1ST);
+	}
+}
+
+TEST(feed_not_a_feed)
+{
+	feed::Feed out;
+	CHECK(!parse("<html><body/></html>", out));
+	CHECK(!parse("<rss><channel>", out));
+}
+
+TEST(feed_file)
+{
+	const char* path = "feed_test.xml";
+	FILE* f = fopen(path, "wb");
+	CHECK(!!f);
+	if (!f)
+		return;
+	fwrite(atom, 1, strlen(atom), f);
+	fclose(f);
+
+	for (int pass = 0; pass < 2; ++pass) // the second one with the pooled parser
+	{
+		feed::Feed out;
+		CHECK(feed::parseFile(path, out));
+		CHECK_EQ(out.format, feed::ATOM);
+		CHECK_EQ(out.items.size(), 1u);
+	}
+
+	remove(path);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifndef LIBWEB_TRACK_ALLOCATIONS
+namespace tests
+{
+	static thread_local size_t counted = 0;
+	size_t allocations() { return counted; }
+}
+
+void* operator new(size_t size)
+{
+	++tests::counted;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+#endif
+
+namespace tests
+{
+	static Test* first = nullptr;
+	static Test* last = nullptr;
+	static size_t failures = 0;
+
+	Test::Test(const char* name, void (*run)())
+		: name(name)
+		, run(run)
+		, next(nullptr)
+	{
+		// the order of the files decides the order of the tests
+		if (last)
+			last->next = this;
+		else
+			first = this;
+		last = this;
+	}
+
+	void fail(const char* file, int line, const char* expr)
+	{
+		fprintf(stderr, "%s(%d): failed: %s\n", file, line, expr);
+		++failures;
+	}
+
+	void fail(const char* file, int line, const char* expr, const std::string& lhs, const std::string& rhs)
+	{
+		fprintf(stderr, "%s(%d): failed: %s\n    left:  %s\n    right: %s\n", file, line, expr, lhs.c_str(), rhs.c_str());
+		++failures;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* prefix = argc > 1 ? argv[1] : "";
+	size_t length = strlen(prefix);
+
+	size_t run = 0, failed = 0;
+	for (auto test = tests::first; test; test = test->next)
+	{
+		if (strncmp(test->name, prefix, length))
+			continue;
+
+		size_t before = tests::failures;
+		test->run();
+		++run;
+
+		bool passed = before == tests::failures;
+		if (!passed)
+			++failed;
+		printf("[%s] %s\n", passed ? "  OK  " : "FAILED", test->name);
+	}
+
+	printf("%zu test(s), %zu failed\n", run, failed);
+	return failed ? 1 : 0;
+}
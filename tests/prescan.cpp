@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include "src/dom/parsers/prescan.hpp"
+
+using namespace dom::parsers::html;
+
+namespace
+{
+	std::string bom(const std::string& bytes, size_t expected)
+	{
+		std::string encoding;
+		CHECK_EQ(prescan::bom(bytes.data(), bytes.size(), encoding), expected);
+		return encoding;
+	}
+
+	std::string meta(const std::string& bytes)
+	{
+		std::string encoding;
+		if (!prescan::meta(bytes.data(), bytes.size(), encoding))
+			return "(none)";
+		return encoding;
+	}
+}
+
+TEST(prescan_bom)
+{
+	CHECK_EQ(bom("\xEF\xBB\xBF<html>", 3), std::string("utf-8"));
+	CHECK_EQ(bom("\xFE\xFF\x00<", 2), std::string("utf-16be"));
+	CHECK_EQ(bom("\xFF\xFE<\x00", 2), std::string("utf-16le"));
+	CHECK_EQ(bom("\xEF\xBB", 0), std::string());
+	CHECK_EQ(bom("<html>", 0), std::string());
+}
+
+TEST(prescan_meta)
+{
+	CHECK_EQ(meta("<html><head><meta charset=\"ISO-8859-2\"></head>"), std::string("iso-8859-2"));
+	CHECK_EQ(meta("<meta charset=windows-1250>"), std::string("windows-1250"));
+	CHECK_EQ(meta("<META HTTP-EQUIV=\"Content-Type\" CONTENT=\"text/html; charset=koi8-r\">"), std::string("koi8-r"));
+	CHECK_EQ(meta("<meta content='text/html; charset=\"big5\"' http-equiv='content-type'>"), std::string("big5"));
+
+	// the content needs the pragma, the charset attribute does not
+	CHECK_EQ(meta("<meta content=\"text/html; charset=koi8-r\">"), std::string("(none)"));
+	CHECK_EQ(meta("<meta name=\"viewport\" content=\"width=device-width\">"), std::string("(none)"));
+
+	// the first one wins; utf-16 and x-user-defined are replaced
+	CHECK_EQ(meta("<meta charset=iso-8859-5><meta charset=utf-8>"), std::string("iso-8859-5"));
+	CHECK_EQ(meta("<meta charset=utf-16le>"), std::string("utf-8"));
+	CHECK_EQ(meta("<meta charset=x-user-defined>"), std::string("windows-1252"));
+}
+
+TEST(prescan_meta_skips)
+{
+	CHECK_EQ(meta("<!-- <meta charset=koi8-r> --><meta charset=iso-8859-2>"), std::string("iso-8859-2"));
+	CHECK_EQ(meta("<div title='<meta charset=koi8-r>'><meta charset=iso-8859-2>"), std::string("iso-8859-2"));
+	CHECK_EQ(meta("<metadata charset=koi8-r>"), std::string("(none)"));
+
+	// only the first 1024 bytes count
+	CHECK_EQ(meta(std::string(1020, ' ') + "<meta charset=koi8-r>"), std::string("(none)"));
+	CHECK_EQ(meta(std::string(1000, ' ') + "<meta charset=koi8-r>"), std::string("koi8-r"));
+}
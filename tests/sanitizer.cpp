@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/parsers/html.hpp>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace dom::parsers;
+
+namespace
+{
+	struct StringStream : OutStream
+	{
+		std::string out;
+		void putc(char c) override { out.push_back(c); }
+		void puts(const char* s, size_t length) override { out.append(s, length); }
+	};
+
+	html::Policy links()
+	{
+		html::Policy policy;
+		policy
+			.allow("p", { "class" })
+			.allow("a", { "href", "title" })
+			.allow("img", { "src", "alt" })
+			.allowAttribute("lang")
+			.urlAttribute("href")
+			.urlAttribute("src")
+			.allowScheme("http")
+			.allowScheme("https");
+		return policy;
+	}
+
+	std::string sanitize(const html::SanitizerPtr& sanitizer, const char* text, const std::string& encoding = "utf-8")
+	{
+		StringStream stream;
+		if (!sanitizer || !sanitizer->sanitize(encoding, text, strlen(text), stream))
+			return "(failed)";
+		return stream.out;
+	}
+}
+
+TEST(sanitizer_tags)
+{
+	auto sanitizer = html::createSanitizer(links());
+	CHECK(!!sanitizer);
+
+	CHECK_EQ(sanitize(sanitizer, "<p>Hi</p>"), std::string("<p>Hi</p>"));
+	// not on the list: the tag goes, the text stays
+	CHECK_EQ(sanitize(sanitizer, "<p><span>one</span> <b>two</b></p>"), std::string("<p>one two</p>"));
+	// on the drop list: the contents go, too
+	CHECK_EQ(sanitize(sanitizer, "<script>alert(1)</script><p>ok</p><style>p{}</style>"), std::string("<p>ok</p>"));
+	// comments and foreign content are always removed
+	CHECK_EQ(sanitize(sanitizer, "<p>a<!-- b -->c<svg><text>d</text></svg>e</p>"), std::string("<p>ace</p>"));
+	CHECK_EQ(sanitize(sanitizer, "<p>a<math><mi>x</mi></math>b</p>"), std::string("<p>ab</p>"));
+}
+
+TEST(sanitizer_attributes)
+{
+	auto sanitizer = html::createSanitizer(links());
+
+	CHECK_EQ(sanitize(sanitizer, "<p class=\"x\" onclick=\"evil()\" lang=\"en\">t</p>"), std::string("<p class=\"x\" lang=\"en\">t</p>"));
+	// allowed on a tag, not on the others
+	CHECK_EQ(sanitize(sanitizer, "<a class=\"x\" title=\"t\">l</a>"), std::string("<a title=\"t\">l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<p title=\"a&quot;b\">t</p>"), std::string("<p>t</p>"));
+	CHECK_EQ(sanitize(sanitizer, "<a title='a\"b<c'>l</a>"), std::string("<a title=\"a&quot;b&lt;c\">l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<p>a &lt; b &amp; c</p>"), std::string("<p>a &lt; b &amp; c</p>"));
+	CHECK_EQ(sanitize(sanitizer, "<img src=\"http://example.com/a.png\" alt=\"a\" width=\"10\">"), std::string("<img src=\"http://example.com/a.png\" alt=\"a\"/>"));
+}
+
+TEST(sanitizer_schemes)
+{
+	auto sanitizer = html::createSanitizer(links());
+
+	CHECK_EQ(sanitize(sanitizer, "<a href=\"https://example.com/\">l</a>"), std::string("<a href=\"https://example.com/\">l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<a href=\"HTTP://example.com/\">l</a>"), std::string("<a href=\"HTTP://example.com/\">l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<a href=\"/relative?a=b:c\">l</a>"), std::string("<a href=\"/relative?a=b:c\">l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<a href=\"javascript:alert(1)\">l</a>"), std::string("<a>l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<a href=\" java&#9;script:alert(1)\">l</a>"), std::string("<a>l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<a href=\"data:text/html,x\">l</a>"), std::string("<a>l</a>"));
+	CHECK_EQ(sanitize(sanitizer, "<img src=\"mailto:x@example.com\">"), std::string("<img/>"));
+}
+
+TEST(sanitizer_shared)
+{
+	// one sanitizer for all the threads, with the charsets changing
+	// from one document to the next
+	auto sanitizer = html::createSanitizer(links());
+	const char* inputs[] = {
+		"<p class=\"x\">plain</p>",
+		"<meta charset=\"iso-8859-2\"><p>\xB1\xE6</p>",
+		"\xEF\xBB\xBF<p>bom</p>",
+	};
+	const char* encodings[] = { "utf-8", "", "iso-8859-2" };
+	std::string expected[3];
+	for (size_t i = 0; i < 3; ++i)
+		expected[i] = sanitize(sanitizer, inputs[i], encodings[i]);
+	CHECK_EQ(expected[1], std::string("<p>\xC4\x85\xC4\x87</p>"));
+	CHECK_EQ(expected[2], std::string("<p>bom</p>"));
+
+	std::vector<std::thread> threads;
+	std::vector<size_t> mismatches(4, 0);
+	for (size_t t = 0; t < mismatches.size(); ++t)
+	{
+		threads.emplace_back([&, t] {
+			for (size_t i = 0; i < 300; ++i)
+			{
+				size_t input = (i + t) % 3;
+				if (sanitize(sanitizer, inputs[input], encodings[input]) != expected[input])
+					++mismatches[t];
+			}
+		});
+	}
+	for (auto&& thread : threads)
+		thread.join();
+
+	for (auto count : mismatches)
+		CHECK_EQ(count, 0u);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include "src/dom/nodes/string_pool.hpp"
+#include <vector>
+
+using dom::impl::SharedString;
+using dom::impl::StringPool;
+
+TEST(string_pool_shares)
+{
+	StringPool pool;
+	auto first = pool.intern(std::string("value"));
+	auto second = pool.intern(std::string("value"));
+	CHECK(first == second);
+
+	auto stats = pool.stats();
+	CHECK_EQ(stats.strings, 1u);
+	CHECK_EQ(stats.references, 2u);
+	CHECK_EQ(stats.bytesSaved, 5u);
+}
+
+TEST(string_pool_evicts)
+{
+	StringPool pool;
+	std::vector<SharedString> kept;
+	for (size_t i = 0; i < 100000; ++i)
+	{
+		auto value = pool.intern("value " + std::to_string(i));
+		if (i % 100 == 0)
+			kept.push_back(value);
+	}
+
+	// the dropped values go on the next sweeps; the pool never holds
+	// more than twice the values in use, and the first threshold
+	CHECK(pool.size() <= 2 * 1024 + kept.size());
+	CHECK_EQ(pool.stats().strings, kept.size());
+
+	// the kept values are still the pooled ones
+	CHECK(pool.intern(std::string("value 500")) == kept[5]);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The unit tests of libweb. Every TEST registers itself with the runner
+// in tests/main.cpp; a failed CHECK reports the file and the line, and
+// the runner exits with a non-zero code, if any of the tests failed.
+//
+//   tests [<name prefix>]
+//
+// Links with libweb, the same way the bench does. The AllocCounter
+// counts the C++ allocations of the current thread: through the library's
+// operator new, if built with LIBWEB_TRACK_ALLOCATIONS, and through the
+// runner's own one otherwise.
+
+#ifndef __LIBWEB_TESTS_HPP__
+#define __LIBWEB_TESTS_HPP__
+
+#include <libweb/alloc_scope.hpp>
+#include <cstdio>
+#include <string>
+
+namespace tests
+{
+	struct Test
+	{
+		const char* name;
+		void (*run)();
+		Test* next;
+
+		Test(const char* name, void (*run)());
+	};
+
+#ifdef LIBWEB_TRACK_ALLOCATIONS
+	struct AllocCounter
+	{
+		libweb::alloc_scope scope;
+		size_t count() const { return scope.count(); }
+	};
+#else
+	size_t allocations(); // on this thread
+
+	struct AllocCounter
+	{
+		size_t start = allocations();
+		size_t count() const { return allocations() - start; }
+	};
+#endif
+
+	void fail(const char* file, int line, const char* expr);
+	void fail(const char* file, int line, const char* expr, const std::string& lhs, const std::string& rhs);
+
+	inline std::string str(const std::string& value) { return "\"" + value + "\""; }
+	inline std::string str(const char* value) { return value ? str(std::string(value)) : "nullptr"; }
+	inline std::string str(bool value) { return value ? "true" : "false"; }
+	template <typename T>
+	inline std::string str(const T& value) { return std::to_string(value); }
+
+	template <typename L, typename R>
+	inline bool equal(const char* file, int line, const char* expr, const L& lhs, const R& rhs)
+	{
+		if (lhs == rhs)
+			return true;
+		fail(file, line, expr, str(lhs), str(rhs));
+		return false;
+	}
+}
+
+#define TEST(name) \
+	static void test_##name(); \
+	static tests::Test register_##name(#name, test_##name); \
+	static void test_##name()
+
+#define CHECK(expr) \
+	do { if (!(expr)) tests::fail(__FILE__, __LINE__, #expr); } while (0)
+
+#define CHECK_EQ(lhs, rhs) \
+	tests::equal(__FILE__, __LINE__, #lhs " == " #rhs, (lhs), (rhs))
+
+#endif // __LIBWEB_TESTS_HPP__
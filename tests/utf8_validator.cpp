@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include "src/dom/parsers/utf8_validator.hpp"
+
+using dom::parsers::validUtf8;
+
+namespace
+{
+	size_t valid(const std::string& bytes)
+	{
+		return validUtf8(bytes.data(), bytes.size());
+	}
+
+	// the same bytes after a run of ASCII, which is long enough for the
+	// vector loop to go over it first, and at every alignment
+	void checkAfterAscii(const std::string& bytes, size_t expected)
+	{
+		for (size_t lead = 0; lead < 40; ++lead)
+		{
+			std::string text(lead, 'a');
+			text += bytes;
+			CHECK_EQ(valid(text), lead + expected);
+		}
+	}
+}
+
+TEST(utf8_valid)
+{
+	CHECK_EQ(valid(""), 0u);
+	CHECK_EQ(valid("plain ASCII"), 11u);
+	CHECK_EQ(valid(std::string("\0x", 2)), 2u);
+	CHECK_EQ(valid("\xC2\x80"), 2u);                   // U+0080
+	CHECK_EQ(valid("\xDF\xBF"), 2u);                   // U+07FF
+	CHECK_EQ(valid("\xE0\xA0\x80"), 3u);               // U+0800
+	CHECK_EQ(valid("\xED\x9F\xBF"), 3u);               // U+D7FF
+	CHECK_EQ(valid("\xEE\x80\x80"), 3u);               // U+E000
+	CHECK_EQ(valid("\xEF\xBF\xBF"), 3u);               // U+FFFF
+	CHECK_EQ(valid("\xF0\x90\x80\x80"), 4u);           // U+10000
+	CHECK_EQ(valid("\xF4\x8F\xBF\xBF"), 4u);           // U+10FFFF
+	CHECK_EQ(valid("za\xC5\xBC\xC3\xB3\xC5\x82\xC4\x87"), 10u);
+}
+
+TEST(utf8_invalid)
+{
+	// the length of the valid prefix
+	CHECK_EQ(valid("ab\x80"), 2u);                     // lone continuation
+	CHECK_EQ(valid("ab\xC0\xAF"), 2u);                 // overlong '/'
+	CHECK_EQ(valid("ab\xC1\xBF"), 2u);
+	CHECK_EQ(valid("ab\xE0\x9F\xBF"), 2u);             // overlong U+07FF
+	CHECK_EQ(valid("ab\xF0\x8F\xBF\xBF"), 2u);         // overlong U+FFFF
+	CHECK_EQ(valid("ab\xED\xA0\x80"), 2u);             // U+D800
+	CHECK_EQ(valid("ab\xED\xBF\xBF"), 2u);             // U+DFFF
+	CHECK_EQ(valid("ab\xF4\x90\x80\x80"), 2u);         // U+110000
+	CHECK_EQ(valid("ab\xF5\x80\x80\x80"), 2u);
+	CHECK_EQ(valid("ab\xFE"), 2u);
+	CHECK_EQ(valid("ab\xFF"), 2u);
+	CHECK_EQ(valid("ab\xC3\x28"), 2u);                 // no continuation
+	CHECK_EQ(valid("ab\xE2\x82\x28"), 2u);
+	CHECK_EQ(valid("\xC5\xBC\xF0\x9F\x98"), 2u);       // cut short by the end
+	CHECK_EQ(valid("\xE2\x82"), 0u);
+}
+
+TEST(utf8_vector_path)
+{
+	checkAfterAscii("", 0);
+	checkAfterAscii("\xC5\xBC", 2);
+	checkAfterAscii("\xF0\x9F\x98\x80", 4);
+	checkAfterAscii("\x80", 0);
+	checkAfterAscii("\xED\xA0\x80", 0);
+	checkAfterAscii("\xF0\x9F\x98", 0);
+	checkAfterAscii("\xC5\xBC" "abcdefghijklmnopqrstuvwxyz0123456789" "\xFF", 38);
+
+	// an invalid byte far into a long ASCII run
+	std::string text(1000, 'x');
+	text[777] = '\x80';
+	CHECK_EQ(valid(text), 777u);
+	text[777] = '\x7F';
+	CHECK_EQ(valid(text), 1000u);
+}
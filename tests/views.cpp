@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/dom.hpp>
+#include <dom/parsers/xml.hpp>
+#include <vector>
+
+// The *View accessors and visitAttributes read the parsed values in
+// place: not a single allocation, in either kind of document.
+
+namespace
+{
+	const char text[] =
+		"<feed xmlns='urn:test' lang='en'>"
+		"<entry id='first' rel='alternate' href='http://example.com/1'>One<b class='x'>bold</b></entry>"
+		"<entry id='second' rel='alternate' href='http://example.com/2'>Two &amp; three</entry>"
+		"</feed>";
+
+	struct Counter : dom::AttributeVisitor
+	{
+		size_t count = 0;
+		size_t length = 0;
+		void onAttribute(const dom::string_view& name, const dom::string_view& value) override
+		{
+			++count;
+			length += name.length() + value.length();
+		}
+	};
+
+	void collect(const dom::NodePtr& node, std::vector<dom::NodePtr>& out)
+	{
+		out.push_back(node);
+		auto children = node->childNodes();
+		for (size_t i = 0, count = children ? children->length() : 0; i < count; ++i)
+			collect(children->item(i), out);
+	}
+
+	void checkViews(dom::parsers::DOCUMENT_MODE mode)
+	{
+		auto doc = dom::parsers::xml::parseDocument("", text, sizeof(text) - 1, mode);
+		CHECK(!!doc);
+		if (!doc)
+			return;
+
+		std::vector<dom::NodePtr> nodes;
+		collect(doc->documentElement(), nodes);
+		std::vector<dom::Element*> elements;
+		for (auto&& node : nodes)
+		{
+			if (node->nodeType() == dom::ELEMENT_NODE)
+				elements.push_back(static_cast<dom::Element*>(node.get()));
+		}
+
+		const std::string names[] = { "id", "rel", "href", "class", "missing" };
+		Counter visitor;
+		size_t found = 0, length = 0;
+
+		tests::AllocCounter allocs;
+		for (auto elem : elements)
+		{
+			for (auto&& name : names)
+				found += elem->getAttributeView(name).length();
+			elem->visitAttributes(visitor);
+		}
+		for (auto&& node : nodes)
+			length += node->nodeValueView().length() + node->nodeNameView().length();
+		CHECK_EQ(allocs.count(), 0u);
+
+		CHECK(found > 0);
+		CHECK(length > 0);
+		CHECK(visitor.count >= 8);
+	}
+}
+
+TEST(views_mutable)
+{
+	checkViews(dom::parsers::MUTABLE_DOCUMENT);
+}
+
+TEST(views_readonly)
+{
+	checkViews(dom::parsers::READONLY_DOCUMENT);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/dom.hpp>
+#include <dom/parsers/xml.hpp>
+
+namespace
+{
+	const char unbound[] = "<rss><channel><item><dc:creator>Someone</dc:creator></item></channel></rss>";
+	const char declared[] = "<a x='1' xmlns='urn:a' y='2' xmlns:p='urn:p' p:z='3'><p:b/></a>";
+
+	dom::DocumentPtr parse(const dom::parsers::ParserPtr& parser, const char* text)
+	{
+		return dom::parsers::parseDocument(parser, text, strlen(text));
+	}
+
+	std::string names(const dom::ElementPtr& elem)
+	{
+		std::string out;
+		auto attrs = elem->getAttributes();
+		for (size_t i = 0, count = attrs ? attrs->length() : 0; i < count; ++i)
+			out += attrs->item(i)->nodeName() + ",";
+		return out;
+	}
+
+	void checkDeclared(const dom::DocumentPtr& doc)
+	{
+		CHECK(!!doc);
+		if (!doc)
+			return;
+
+		auto root = doc->documentElement();
+		// the declarations are kept as attributes; all ordered by name
+		CHECK_EQ(names(root), std::string("p:z,x,xmlns,xmlns:p,y,"));
+		CHECK_EQ(root->nodeQName().nsName, std::string("urn:a"));
+		CHECK_EQ(root->getAttributeNode("p:z")->nodeQName().nsName, std::string("urn:p"));
+		CHECK_EQ(root->getAttributeNode("p:z")->nodeQName().localName, std::string("z"));
+
+		auto child = root->firstChild();
+		CHECK_EQ(child->nodeName(), std::string("p:b"));
+		CHECK_EQ(child->nodeQName().nsName, std::string("urn:p"));
+		CHECK_EQ(child->nodeQName().localName, std::string("b"));
+	}
+}
+
+TEST(xml_unbound_prefix)
+{
+	// the default parsers keep the feeds using undeclared prefixes
+	auto doc = dom::parsers::xml::parseDocument("", unbound, sizeof(unbound) - 1);
+	CHECK(!!doc);
+	auto creators = doc ? doc->getElementsByTagName("dc:creator") : nullptr;
+	CHECK(creators && creators->length() == 1);
+	if (creators && creators->length())
+		CHECK_EQ(creators->item(0)->stringValue(), std::string("Someone"));
+
+	CHECK(!!parse(dom::parsers::xml::create(""), unbound));
+	CHECK(!parse(dom::parsers::xml::createNS(""), unbound));
+}
+
+TEST(xml_namespaces)
+{
+	checkDeclared(parse(dom::parsers::xml::create(""), declared));
+	checkDeclared(parse(dom::parsers::xml::createNS(""), declared));
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tests.hpp"
+#include <dom/dom.hpp>
+#include <dom/parsers/xml.hpp>
+
+// The //tag[@name='value'] answered by an attribute index must find the
+// same nodes, in the same order, as the generic walk.
+
+namespace
+{
+	std::string ids(const dom::NodeListPtr& list)
+	{
+		std::string out;
+		for (size_t i = 0, count = list ? list->length() : 0; i < count; ++i)
+		{
+			auto elem = std::static_pointer_cast<dom::Element>(list->element(i));
+			out += elem ? elem->getAttribute("id") : "?";
+			out += ",";
+		}
+		return out;
+	}
+
+	dom::DocumentPtr parse(const std::string& text)
+	{
+		return dom::parsers::xml::parseDocument("", text.data(), text.size(), dom::parsers::MUTABLE_DOCUMENT);
+	}
+
+	std::string tree()
+	{
+		std::string text = "<r>";
+		for (int i = 0; i < 12; ++i)
+		{
+			text += "<s id='s" + std::to_string(i) + "' k='" + std::to_string(i % 3) + "'>";
+			for (int j = 0; j < 4; ++j)
+				text += "<t id='t" + std::to_string(i) + "_" + std::to_string(j) + "' k='" + std::to_string(j % 3) + "'><u id='u" + std::to_string(i * 4 + j) + "' k='1'/></t>";
+			text += "</s>";
+		}
+		return text + "</r>";
+	}
+
+	const char* paths[] = {
+		"//t[@k='1']", "//s[@k='0']", "//s//t[@k='2']", "//s//u[@k='1']", "/r/s//*[@k='1']", "//*[@k='1']"
+	};
+
+	void compare(const dom::DocumentPtr& plain, const dom::DocumentPtr& indexed)
+	{
+		for (auto path : paths)
+		{
+			CHECK_EQ(ids(indexed->findall(path, nullptr)), ids(plain->findall(path, nullptr)));
+
+			auto left = plain->documentElement()->childNodes();
+			auto right = indexed->documentElement()->childNodes();
+			for (size_t i = 0; i < left->length(); i += 5)
+			{
+				std::string local = std::string("self::node()") + path;
+				CHECK_EQ(ids(right->item(i)->findall(local, nullptr)), ids(left->item(i)->findall(local, nullptr)));
+			}
+		}
+	}
+}
+
+TEST(xpath_index_order)
+{
+	const std::string text = "<root><div id='d'><a id='a1' rel='x'/></div><a id='a2' rel='x'/></root>";
+	auto plain = parse(text);
+	auto indexed = parse(text);
+	CHECK(indexed->indexAttribute("rel"));
+
+	CHECK_EQ(ids(plain->findall("//a[@rel='x']", nullptr)), std::string("a2,a1,"));
+	CHECK_EQ(ids(indexed->findall("//a[@rel='x']", nullptr)), std::string("a2,a1,"));
+
+	// the plain lookup stays in the document order
+	CHECK_EQ(ids(indexed->getElementsByAttribute("rel", "x")), std::string("a1,a2,"));
+}
+
+TEST(xpath_index_tree)
+{
+	auto plain = parse(tree());
+	auto indexed = parse(tree());
+	CHECK(indexed->indexAttribute("k"));
+	compare(plain, indexed);
+}
+
+TEST(xpath_index_mutations)
+{
+	auto plain = parse(tree());
+	auto indexed = parse(tree());
+	CHECK(indexed->indexAttribute("k"));
+
+	for (auto doc : { plain, indexed })
+	{
+		auto root = doc->documentElement();
+		auto kids = root->childNodes();
+		auto third = kids->item(3);
+		root->removeChild(third);
+		root->appendChild(third);
+
+		auto tenth = kids->item(10);
+		root->removeChild(tenth);
+		root->insertBefore(tenth, kids->item(0));
+		root->removeChild(kids->item(7));
+
+		auto moved = kids->item(5)->childNodes()->item(2);
+		kids->item(6)->appendChild(moved);
+		std::static_pointer_cast<dom::Element>(kids->item(8))->setAttribute("k", "2");
+	}
+
+	compare(plain, indexed);
+}
+
+TEST(xpath_index_detached)
+{
+	auto plain = parse(tree());
+	auto indexed = parse(tree());
+	CHECK(indexed->indexAttribute("k"));
+
+	dom::NodePtr left, right;
+	for (auto doc : { plain, indexed })
+	{
+		auto root = doc->documentElement();
+		auto branch = root->childNodes()->item(4);
+		root->removeChild(branch);
+		(doc == plain ? left : right) = branch;
+	}
+
+	// the index does not see the branch, the generic walk does
+	auto found = right->findall("self::node()//t[@k='1']", nullptr);
+	CHECK_EQ(ids(found), std::string("t4_1,"));
+	CHECK_EQ(ids(found), ids(left->findall("self::node()//t[@k='1']", nullptr)));
+	CHECK_EQ(indexed->getElementsByAttribute("k", "1", right)->length(), 0u);
+
+	// and sees it again, once it is back
+	indexed->documentElement()->appendChild(right);
+	CHECK_EQ(ids(indexed->getElementsByAttribute("k", "1", right)), std::string("u16,t4_1,u17,u18,u19,"));
+}
+
+TEST(xpath_index_fragment)
+{
+	auto doc = parse("<r/>");
+	CHECK(doc->indexAttribute("k"));
+
+	auto fragment = doc->createDocumentFragment();
+	doc->setFragment(fragment);
+	for (int i = 0; i < 3; ++i)
+	{
+		auto outer = doc->createElement("p");
+		outer->setAttribute("id", "p" + std::to_string(i));
+		outer->setAttribute("k", "1");
+		auto inner = doc->createElement("p");
+		inner->setAttribute("id", "q" + std::to_string(i));
+		inner->setAttribute("k", "1");
+		outer->appendChild(inner);
+		fragment->appendChild(outer);
+	}
+
+	CHECK_EQ(ids(doc->findall("//p[@k='1']", nullptr)), std::string("p0,p1,p2,q0,q1,q2,"));
+	CHECK_EQ(ids(fragment->findall("self::node()//p[@k='1']", nullptr)), std::string("p0,p1,p2,q0,q1,q2,"));
+	CHECK_EQ(ids(doc->getElementsByAttribute("k", "1")), std::string("p0,q0,p1,q1,p2,q2,"));
+}
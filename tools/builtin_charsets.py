@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2013 midnightBITS
+#
+# Generates src/dom/parsers/builtin_charsets.hpp, the single-byte charsets
+# compiled into the library. The tables come from the Python codecs; run
+#
+#     python3 tools/builtin_charsets.py > src/dom/parsers/builtin_charsets.hpp
+#
+# after changing the list below.
+
+import codecs
+import sys
+
+# (canonical name, Python codec, aliases)
+CHARSETS = [
+	("windows-1250", "cp1250", ["cp1250", "x-cp1250"]),
+	("windows-1251", "cp1251", ["cp1251", "x-cp1251"]),
+	("windows-1252", "cp1252", ["cp1252", "x-cp1252"]),
+	("windows-1253", "cp1253", ["cp1253", "x-cp1253"]),
+	("windows-1254", "cp1254", ["cp1254", "x-cp1254"]),
+	("windows-1255", "cp1255", ["cp1255", "x-cp1255"]),
+	("windows-1256", "cp1256", ["cp1256", "x-cp1256"]),
+	("windows-1257", "cp1257", ["cp1257", "x-cp1257"]),
+	("windows-1258", "cp1258", ["cp1258", "x-cp1258"]),
+	("iso-8859-1", "iso8859_1", ["latin1", "l1", "csisolatin1", "iso-ir-100"]),
+	("iso-8859-2", "iso8859_2", ["latin2", "l2", "csisolatin2", "iso-ir-101"]),
+	("iso-8859-3", "iso8859_3", ["latin3", "l3", "csisolatin3", "iso-ir-109"]),
+	("iso-8859-4", "iso8859_4", ["latin4", "l4", "csisolatin4", "iso-ir-110"]),
+	("iso-8859-5", "iso8859_5", ["cyrillic", "csisolatincyrillic", "iso-ir-144"]),
+	("iso-8859-6", "iso8859_6", ["arabic", "csisolatinarabic", "iso-ir-127"]),
+	("iso-8859-7", "iso8859_7", ["greek", "greek8", "csisolatingreek", "iso-ir-126"]),
+	("iso-8859-8", "iso8859_8", ["hebrew", "csisolatinhebrew", "iso-ir-138"]),
+	("iso-8859-9", "iso8859_9", ["latin5", "l5", "csisolatin5", "iso-ir-148"]),
+	("iso-8859-10", "iso8859_10", ["latin6", "l6", "csisolatin6", "iso-ir-157"]),
+	("iso-8859-13", "iso8859_13", []),
+	("iso-8859-14", "iso8859_14", ["latin8", "l8"]),
+	("iso-8859-15", "iso8859_15", ["latin-9", "l9"]),
+	("iso-8859-16", "iso8859_16", ["latin10", "l10"]),
+	("koi8-r", "koi8_r", ["koi8", "koi", "cskoi8r"]),
+	("koi8-u", "koi8_u", ["koi8-ru"]),
+]
+
+UNDEFINED = 0xFFFF
+
+LICENSE = """/*
+ * Copyright (C) 2013 midnightBITS
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+"""
+
+def upper_half(codec):
+	for byte in range(0x80):
+		assert bytes([byte]).decode(codec) == chr(byte), codec
+	table = []
+	for byte in range(0x80, 0x100):
+		try:
+			table.append(ord(bytes([byte]).decode(codec)))
+		except UnicodeDecodeError:
+			table.append(UNDEFINED)
+	return table
+
+def ident(name):
+	return name.replace("-", "_")
+
+def main(out):
+	out.write(LICENSE)
+	out.write("""
+// Generated by tools/builtin_charsets.py; do not edit.
+
+#ifndef __DOM_INTERNAL_BUILTIN_CHARSETS_HPP__
+#define __DOM_INTERNAL_BUILTIN_CHARSETS_HPP__
+
+#include <cstdint>
+
+namespace dom { namespace parsers { namespace builtin {
+
+	// Bytes 0x80-0xFF of each charset; the lower half is ASCII in all
+	// of them. 0xFFFF marks the bytes the charset leaves undefined.
+""")
+	for name, codec, _ in CHARSETS:
+		table = upper_half(codec)
+		out.write("\n\tconstexpr uint16_t %s[128] = {\n" % ident(name))
+		for row in range(0, 128, 8):
+			out.write("\t\t%s,\n" % ", ".join("0x%04X" % c for c in table[row:row + 8]))
+		out.write("\t};\n")
+
+	out.write("\n\tconstexpr const uint16_t* tables[] = {\n")
+	for name, _, _ in CHARSETS:
+		out.write("\t\t%s,\n" % ident(name))
+	out.write("\t};\n")
+
+	names = []
+	for index, (name, _, aliases) in enumerate(CHARSETS):
+		for alias in [name] + aliases:
+			names.append((alias, index))
+		if name.startswith("iso-8859-"):
+			number = name[len("iso-8859-"):]
+			names.append(("iso8859-" + number, index))
+			names.append(("iso_8859-" + number, index))
+			names.append(("iso8859_" + number, index))
+	names.sort()
+	assert len(set(n for n, _ in names)) == len(names)
+
+	out.write("""
+	struct Alias
+	{
+		const char* name;
+		unsigned index; // into tables
+	};
+
+	// Lowercase and sorted, for a binary search
+	constexpr Alias aliases[] = {
+""")
+	for alias, index in names:
+		out.write("\t\t{ \"%s\", %d },\n" % (alias, index))
+	out.write("""	};
+}}}
+
+#endif // __DOM_INTERNAL_BUILTIN_CHARSETS_HPP__
+""")
+
+if __name__ == "__main__":
+	main(sys.stdout)